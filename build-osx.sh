@@ -21,15 +21,16 @@ RAYLIB_SRC="../../src"
 set -e
 
 # Get arguments
-while getopts ":hdusrcq" opt; do
+while getopts ":hdusrtcq" opt; do
     case $opt in
         h)
-            echo "Usage: ./build-osx.sh [-hdusrcqq]"
+            echo "Usage: ./build-osx.sh [-hdusrtcqq]"
             echo " -h  Show this information"
             echo " -d  Faster builds that have debug symbols, and enable warnings"
             echo " -u  Run upx* on the executable after compilation (before -r)"
             echo " -s  Run strip on the executable after compilation (before -r)"
             echo " -r  Run the executable after compilation"
+            echo " -t  Check the golden frames in replays/ after compilation (before -r)"
             echo " -c  Remove the temp/(debug|release) directory, ie. full recompile"
             echo " -q  Suppress this script's informational prints"
             echo " -qq Suppress all prints, complete silence (> /dev/null 2>&1)"
@@ -42,6 +43,7 @@ while getopts ":hdusrcq" opt; do
             echo " Build a release build:                    ./build-osx.sh"
             echo " Build a release build, full recompile:    ./build-osx.sh -c"
             echo " Build a debug build and run:              ./build-osx.sh -d -r"
+            echo " Build a release build and test it:        ./build-osx.sh -t"
             echo " Build in debug, run, don't print at all:  ./build-osx.sh -drqq"
             exit 0
             ;;
@@ -57,6 +59,9 @@ while getopts ":hdusrcq" opt; do
         r)
             RUN_AFTER_BUILD="1"
             ;;
+        t)
+            TEST_AFTER_BUILD="1"
+            ;;
         c)
             BUILD_ALL="1"
             ;;
@@ -93,7 +98,7 @@ LINK_FLAGS="-flto -framework OpenGL -framework OpenAL -framework IOKit -framewor
 # Debug changes to flags
 if [ -n "$BUILD_DEBUG" ]; then
     OUTPUT_DIR="builds-debug/osx"
-    COMPILATION_FLAGS="-std=c99 -O0 -g"
+    COMPILATION_FLAGS="-std=c99 -O0 -g -DPACMAN_DEBUG"
     FINAL_COMPILE_FLAGS=""
     LINK_FLAGS="-framework OpenGL -framework OpenAL -framework IOKit -framework CoreVideo -framework Cocoa"
 fi
@@ -134,6 +139,20 @@ if [ ! -d "$TEMP_DIR" ]; then
     cd $ROOT_DIR
 fi
 
+# Bake the texture atlas, the game includes the header it generates
+mkdir -p $TEMP_DIR/bake
+cd $TEMP_DIR/bake
+[ -z "$QUIET" ] && echo "COMPILE-INFO: Baking the texture atlas."
+if [ -n "$REALLY_QUIET" ]; then
+    $CC -o bake_atlas -I$RAYLIB_SRC $COMPILATION_FLAGS $WARNING_FLAGS $ROOT_DIR/src/bake_atlas.c $ROOT_DIR/$TEMP_DIR/*.o $LINK_FLAGS > /dev/null 2>&1
+    cd $ROOT_DIR
+    $TEMP_DIR/bake/bake_atlas > /dev/null 2>&1
+else
+    $CC -o bake_atlas -I$RAYLIB_SRC $COMPILATION_FLAGS $WARNING_FLAGS $ROOT_DIR/src/bake_atlas.c $ROOT_DIR/$TEMP_DIR/*.o $LINK_FLAGS
+    cd $ROOT_DIR
+    $TEMP_DIR/bake/bake_atlas
+fi
+
 # Build the actual game
 mkdir -p $OUTPUT_DIR
 cd $OUTPUT_DIR
@@ -158,6 +177,19 @@ if [ -n "$UPX_IT" ]; then
     upx $GAME_NAME > /dev/null 2>&1
 fi
 
+# The golden run loads the assets relative to the working directory, and a
+# mismatch stops the script through set -e.
+if [ -n "$TEST_AFTER_BUILD" ]; then
+    [ -z "$QUIET" ] && echo "COMPILE-INFO: Checking the golden frames."
+    cd $ROOT_DIR
+    if [ -n "$REALLY_QUIET" ]; then
+        $OUTPUT_DIR/$GAME_NAME --golden replays > /dev/null 2>&1
+    else
+        $OUTPUT_DIR/$GAME_NAME --golden replays
+    fi
+    cd $OUTPUT_DIR
+fi
+
 if [ -n "$RUN_AFTER_BUILD" ]; then
     [ -z "$QUIET" ] && echo "COMPILE-INFO: Running."
     if [ -n "$REALLY_QUIET" ]; then
@@ -66,6 +66,9 @@ IF NOT "x!ARG!" == "x!ARG:u=!" (
 IF NOT "x!ARG!" == "x!ARG:r=!" (
   set RUN_AFTER_BUILD=1
 )
+IF NOT "x!ARG!" == "x!ARG:t=!" (
+  set TEST_AFTER_BUILD=1
+)
 IF NOT "x!ARG!" == "x!ARG:c=!" (
   set BUILD_ALL=1
 )
@@ -89,11 +92,12 @@ IF NOT "%1" == "" (
 
 
 :HELP
-echo Usage: build-windows.bat [-hdurcqqv]
+echo Usage: build-windows.bat [-hdurtcqqv]
 echo  -h  Show this information
 echo  -d  Faster builds that have debug symbols, and enable warnings
 echo  -u  Run upx* on the executable after compilation (before -r)
 echo  -r  Run the executable after compilation
+echo  -t  Check the golden frames in replays\ after compilation (before -r)
 echo  -c  Remove the temp\{debug,release} directory, ie. full recompile
 echo  -q  Suppress this script's informational prints
 echo  -qq Suppress all prints, complete silence
@@ -110,6 +114,7 @@ echo Examples:
 echo  Build a release build:                    build-windows.bat
 echo  Build a release build, full recompile:    build-windows.bat -c
 echo  Build a debug build and run:              build-windows.bat -d -r
+echo  Build a release build and test it:        build-windows.bat -t
 echo  Build in debug, run, don't print at all:  build-windows.bat -drqq
 exit /B
 
@@ -130,7 +135,7 @@ set OUTPUT_DIR=builds\windows-msvc
 REM Debug changes to flags
 IF DEFINED BUILD_DEBUG (
   set OUTPUT_FLAG=/Fe: "!GAME_NAME!"
-  set COMPILATION_FLAGS=/std:c11 /Od /Zi /utf-8 /validate-charset /EHsc
+  set COMPILATION_FLAGS=/std:c11 /Od /Zi /utf-8 /validate-charset /EHsc /DPACMAN_DEBUG
   set WARNING_FLAGS=/W3 /sdl
   set SUBSYSTEM_FLAGS=/DEBUG
   set LINK_FLAGS=/link kernel32.lib user32.lib shell32.lib winmm.lib gdi32.lib opengl32.lib
@@ -181,6 +186,20 @@ IF NOT EXIST !TEMP_DIR!\ (
   cd !ROOT_DIR!
 )
 
+REM Bake the texture atlas, the game includes the header it generates
+IF NOT EXIST !TEMP_DIR!\bake mkdir !TEMP_DIR!\bake
+cd !TEMP_DIR!\bake
+IF NOT DEFINED QUIET echo COMPILE-INFO: Baking the texture atlas.
+IF DEFINED REALLY_QUIET (
+  cl.exe !VERBOSITY_FLAG! !COMPILATION_FLAGS! /Fe: "bake_atlas.exe" /I"!RAYLIB_SRC!" "!ROOT_DIR!\src\bake_atlas.c" "!ROOT_DIR!\!TEMP_DIR!\*.obj" !LINK_FLAGS! > NUL 2>&1 || exit /B
+  cd !ROOT_DIR!
+  !TEMP_DIR!\bake\bake_atlas.exe > NUL 2>&1 || exit /B
+) ELSE (
+  cl.exe !VERBOSITY_FLAG! !COMPILATION_FLAGS! /Fe: "bake_atlas.exe" /I"!RAYLIB_SRC!" "!ROOT_DIR!\src\bake_atlas.c" "!ROOT_DIR!\!TEMP_DIR!\*.obj" !LINK_FLAGS! || exit /B
+  cd !ROOT_DIR!
+  !TEMP_DIR!\bake\bake_atlas.exe || exit /B
+)
+
 REM Move to the build directory
 IF NOT EXIST !OUTPUT_DIR! mkdir !OUTPUT_DIR!
 cd !OUTPUT_DIR!
@@ -203,6 +222,18 @@ IF DEFINED UPX_IT (
   upx !GAME_NAME! > NUL 2>&1
 )
 
+REM Check the golden frames, the assets load relative to the working directory
+IF DEFINED TEST_AFTER_BUILD (
+  IF NOT DEFINED QUIET echo COMPILE-INFO: Checking the golden frames.
+  cd !ROOT_DIR!
+  IF DEFINED REALLY_QUIET (
+    !OUTPUT_DIR!\!GAME_NAME! --golden replays > NUL 2>&1 || exit /B
+  ) ELSE (
+    !OUTPUT_DIR!\!GAME_NAME! --golden replays || exit /B
+  )
+  cd !OUTPUT_DIR!
+)
+
 REM Finally, run the produced executable
 IF DEFINED RUN_AFTER_BUILD (
   IF NOT DEFINED QUIET echo COMPILE-INFO: Running.
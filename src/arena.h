@@ -0,0 +1,98 @@
+#ifndef ARENA_H
+
+// Linear allocators over reserved address space. Pages are committed as an
+// arena grows and stay committed when temporary memory is handed back, so
+// once an arena has seen its largest load, a push is a bump of `used`.
+// Pushed memory is zeroed, like MemAlloc's. Arenas aren't thread-safe; each
+// one is only pushed on by the thread that owns it.
+
+#include <string.h>
+
+#include "defines.h"
+#include "platform.h"
+
+#define ARENA_COMMIT_SIZE (64 * 1024)
+#define ARENA_DEFAULT_ALIGNMENT 16
+
+typedef struct {
+    const char *name;
+    u8 *base;
+    u64 reserved;
+    u64 committed;
+    u64 used;
+    u64 peak;
+} Arena;
+
+// Lets a caller hand back everything it pushed after taking the mark.
+typedef struct {
+    Arena *arena;
+    u64 used;
+} TempMemory;
+
+// Bumped by every allocation the thread makes, so a caller can check that a
+// stretch of code didn't allocate by comparing it before and after.
+thread_global u64 allocation_count = 0;
+
+internal b32 init_arena(Arena *arena, const char *name, u64 reserved) {
+    *arena = (Arena){0};
+    arena->name = name;
+    arena->base = (u8 *)reserve_memory(reserved);
+    if (!arena->base) {
+        TraceLog(LOG_ERROR, "ARENA: [%s] Failed to reserve %llu bytes", name,
+                 reserved);
+        return 0;
+    }
+    arena->reserved = reserved;
+    return 1;
+}
+
+// Returns 0 when the arena is out of room. `alignment` is a power of two.
+internal void *push_size(Arena *arena, u64 size, u64 alignment) {
+    u64 offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    u64 end = offset + size;
+    if (end > arena->reserved) {
+        TraceLog(LOG_ERROR, "ARENA: [%s] Out of room for %llu bytes",
+                 arena->name, size);
+        return 0;
+    }
+    if (end > arena->committed) {
+        u64 committed = (end + ARENA_COMMIT_SIZE - 1) &
+                        ~(u64)(ARENA_COMMIT_SIZE - 1);
+        if (committed > arena->reserved) {
+            committed = arena->reserved;
+        }
+        if (!commit_memory(arena->base + arena->committed,
+                           committed - arena->committed)) {
+            TraceLog(LOG_ERROR, "ARENA: [%s] Failed to commit %llu bytes",
+                     arena->name, committed);
+            return 0;
+        }
+        arena->committed = committed;
+    }
+
+    arena->used = end;
+    if (end > arena->peak) {
+        arena->peak = end;
+    }
+    allocation_count++;
+    void *result = arena->base + offset;
+    memset(result, 0, size);
+    return result;
+}
+
+#define push_array(arena, type, count)                                   \
+    ((type *)push_size((arena), (u64)(count) * sizeof(type),             \
+                       ARENA_DEFAULT_ALIGNMENT))
+#define push_struct(arena, type) push_array(arena, type, 1)
+
+internal TempMemory begin_temp_memory(Arena *arena) {
+    TempMemory result = {arena, arena->used};
+    return result;
+}
+
+internal void end_temp_memory(TempMemory temp) {
+    temp.arena->used = temp.used;
+}
+
+#define ARENA_H
+#endif
@@ -0,0 +1,28 @@
+#ifndef ATLAS_H
+
+// Everything the game draws comes from a single texture, assets/atlas.png.
+// It is baked at build time by src/bake_atlas.c, which also writes
+// src/atlas_generated.h with where each sprite tile, maze and glyph ended up.
+
+#include "defines.h"
+
+#define ATLAS_FIRST_GLYPH 32
+#define ATLAS_GLYPH_COUNT 95
+#define ATLAS_FONT_COUNT 2
+
+typedef struct {
+    // Zero-sized for glyphs without pixels, like the space.
+    Rectangle rec;
+    i32 offset_x;
+    i32 offset_y;
+    i32 advance_x;
+} AtlasGlyph;
+
+// Glyphs rasterized at exactly the size they are drawn at.
+typedef struct {
+    i32 size;
+    AtlasGlyph glyphs[ATLAS_GLYPH_COUNT];
+} AtlasFont;
+
+#define ATLAS_H
+#endif
@@ -0,0 +1,207 @@
+// Packs the sprite sheet, both maze variants and the font glyphs at the sizes
+// the game draws them into assets/atlas.png, and writes their rectangles to
+// src/atlas_generated.h. Run from the repository root; the build scripts do
+// this before compiling the game.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "raylib.h"
+#include "atlas.h"
+
+#define SPRITE_TILE_SIZE 16
+#define SPRITE_TILES_X 14
+#define SPRITE_TILES_Y 13
+#define MAZE_TILE_COUNT 2
+#define GLYPH_PADDING 1
+#define ATLAS_PATH "assets/atlas.png"
+#define HEADER_PATH "src/atlas_generated.h"
+
+global i32 font_sizes[ATLAS_FONT_COUNT] = {8, 6};
+
+internal void copy_pixels(Image *dst, Image *src, i32 x, i32 y) {
+    u32 *dst_pixels = (u32 *)dst->data;
+    u32 *src_pixels = (u32 *)src->data;
+    for (i32 row = 0; row < src->height; row++) {
+        memcpy(dst_pixels + (y + row) * dst->width + x,
+               src_pixels + row * src->width, src->width * sizeof(u32));
+    }
+}
+
+internal void write_rec(FILE *file, Rectangle rec) {
+    fprintf(file, "{%d, %d, %d, %d}", (i32)rec.x, (i32)rec.y, (i32)rec.width,
+            (i32)rec.height);
+}
+
+internal b32 write_header(const char *path, i32 width, i32 height,
+                          Rectangle *sprite_tiles, Rectangle *maze_tiles,
+                          AtlasFont *fonts) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+
+    fprintf(file, "#ifndef ATLAS_GENERATED_H\n\n");
+    fprintf(file, "// Generated by src/bake_atlas.c, don't edit.\n\n");
+    fprintf(file, "#include \"atlas.h\"\n\n");
+    fprintf(file, "#define ATLAS_WIDTH %d\n", width);
+    fprintf(file, "#define ATLAS_HEIGHT %d\n", height);
+    fprintf(file, "#define ATLAS_SPRITE_TILE_COUNT %d\n",
+            SPRITE_TILES_X * SPRITE_TILES_Y);
+    fprintf(file, "#define ATLAS_MAZE_TILE_COUNT %d\n\n", MAZE_TILE_COUNT);
+
+    fprintf(file, "global Rectangle atlas_sprite_tiles[ATLAS_SPRITE_TILE_COUNT]"
+                  " = {\n");
+    for (i32 i = 0; i < SPRITE_TILES_X * SPRITE_TILES_Y; i++) {
+        fprintf(file, "    ");
+        write_rec(file, sprite_tiles[i]);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "global Rectangle atlas_maze_tiles[ATLAS_MAZE_TILE_COUNT]"
+                  " = {\n");
+    for (i32 i = 0; i < MAZE_TILE_COUNT; i++) {
+        fprintf(file, "    ");
+        write_rec(file, maze_tiles[i]);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "global AtlasFont atlas_fonts[ATLAS_FONT_COUNT] = {\n");
+    for (i32 f = 0; f < ATLAS_FONT_COUNT; f++) {
+        fprintf(file, "    {%d,\n     {\n", fonts[f].size);
+        for (i32 i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+            AtlasGlyph *glyph = &fonts[f].glyphs[i];
+            fprintf(file, "         {");
+            write_rec(file, glyph->rec);
+            fprintf(file, ", %d, %d, %d},\n", glyph->offset_x,
+                    glyph->offset_y, glyph->advance_x);
+        }
+        fprintf(file, "     }},\n");
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "#define ATLAS_GENERATED_H\n#endif\n");
+    fclose(file);
+    return 1;
+}
+
+i32 main() {
+    SetTraceLogLevel(LOG_INFO);
+
+    Image sprite = LoadImage("assets/sprite.png");
+    Image maze = LoadImage("assets/maze.png");
+    i32 font_data_size = 0;
+    u8 *font_data = LoadFileData("assets/PressStart2P.ttf", &font_data_size);
+    if (!sprite.data || !maze.data || !font_data) {
+        TraceLog(LOG_ERROR, "ATLAS: Run from the repository root");
+        return 1;
+    }
+    ImageFormat(&sprite, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    ImageFormat(&maze, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+    // The sprite sheet goes at the origin, so rectangles the game takes from
+    // the sheet directly stay valid. The mazes sit next to it and the glyphs
+    // are packed in rows underneath.
+    i32 width = sprite.width + maze.width;
+    i32 x = 0;
+    i32 y = (sprite.height > maze.height ? sprite.height : maze.height) +
+            GLYPH_PADDING;
+    i32 row_height = 0;
+
+    Rectangle sprite_tiles[SPRITE_TILES_X * SPRITE_TILES_Y];
+    for (i32 tile_y = 0; tile_y < SPRITE_TILES_Y; tile_y++) {
+        for (i32 tile_x = 0; tile_x < SPRITE_TILES_X; tile_x++) {
+            sprite_tiles[tile_y * SPRITE_TILES_X + tile_x] = (Rectangle){
+                (f32)(tile_x * SPRITE_TILE_SIZE),
+                (f32)(tile_y * SPRITE_TILE_SIZE), SPRITE_TILE_SIZE,
+                SPRITE_TILE_SIZE};
+        }
+    }
+
+    Rectangle maze_tiles[MAZE_TILE_COUNT];
+    i32 maze_width = maze.width / MAZE_TILE_COUNT;
+    for (i32 i = 0; i < MAZE_TILE_COUNT; i++) {
+        maze_tiles[i] = (Rectangle){(f32)(sprite.width + i * maze_width), 0,
+                                    (f32)maze_width, (f32)maze.height};
+    }
+
+    GlyphInfo *glyphs[ATLAS_FONT_COUNT];
+    AtlasFont fonts[ATLAS_FONT_COUNT] = {0};
+    for (i32 f = 0; f < ATLAS_FONT_COUNT; f++) {
+        glyphs[f] = LoadFontData(font_data, font_data_size, font_sizes[f], 0,
+                                 ATLAS_GLYPH_COUNT, FONT_BITMAP);
+        if (!glyphs[f]) {
+            TraceLog(LOG_ERROR, "ATLAS: Failed to rasterize the font");
+            return 1;
+        }
+        fonts[f].size = font_sizes[f];
+
+        for (i32 i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+            GlyphInfo *info = &glyphs[f][i];
+            AtlasGlyph *glyph = &fonts[f].glyphs[i];
+            i32 glyph_width = info->image.width;
+            i32 glyph_height = info->image.height;
+            glyph->offset_x = info->offsetX;
+            glyph->offset_y = info->offsetY;
+            glyph->advance_x = info->advanceX ? info->advanceX : glyph_width;
+            if (!info->image.data || glyph_width <= 0 || glyph_height <= 0) {
+                continue;
+            }
+
+            if (x + glyph_width > width) {
+                x = 0;
+                y += row_height + GLYPH_PADDING;
+                row_height = 0;
+            }
+            glyph->rec = (Rectangle){(f32)x, (f32)y, (f32)glyph_width,
+                                     (f32)glyph_height};
+            x += glyph_width + GLYPH_PADDING;
+            if (glyph_height > row_height) {
+                row_height = glyph_height;
+            }
+        }
+    }
+    i32 height = y + row_height;
+
+    Image atlas = GenImageColor(width, height, BLANK);
+    copy_pixels(&atlas, &sprite, 0, 0);
+    copy_pixels(&atlas, &maze, sprite.width, 0);
+
+    // FONT_BITMAP glyphs are grayscale already thresholded to 0 or 255, they
+    // become opaque white so the draw's tint gives them their color.
+    u32 *pixels = (u32 *)atlas.data;
+    for (i32 f = 0; f < ATLAS_FONT_COUNT; f++) {
+        for (i32 i = 0; i < ATLAS_GLYPH_COUNT; i++) {
+            GlyphInfo *info = &glyphs[f][i];
+            Rectangle rec = fonts[f].glyphs[i].rec;
+            u8 *gray = (u8 *)info->image.data;
+            for (i32 py = 0; py < (i32)rec.height; py++) {
+                for (i32 px = 0; px < (i32)rec.width; px++) {
+                    pixels[((i32)rec.y + py) * width + (i32)rec.x + px] =
+                        gray[py * info->image.width + px] ? 0xFFFFFFFF : 0;
+                }
+            }
+        }
+        UnloadFontData(glyphs[f], ATLAS_GLYPH_COUNT);
+    }
+
+    b32 ok = ExportImage(atlas, ATLAS_PATH) &&
+             write_header(HEADER_PATH, width, height, sprite_tiles,
+                          maze_tiles, fonts);
+    if (ok) {
+        TraceLog(LOG_INFO, "ATLAS: Baked %dx%d into %s", width, height,
+                 ATLAS_PATH);
+    } else {
+        TraceLog(LOG_ERROR, "ATLAS: Failed to write %s or %s", ATLAS_PATH,
+                 HEADER_PATH);
+    }
+
+    UnloadImage(atlas);
+    UnloadFileData(font_data);
+    UnloadImage(maze);
+    UnloadImage(sprite);
+    return ok ? 0 : 1;
+}
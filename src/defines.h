@@ -6,6 +6,19 @@
 #define global static
 #define local static
 #define internal static
+// Like global, but every thread gets its own. The simulation's state is, so
+// that replays can be simulated on several threads at once.
+#if defined(_MSC_VER)
+#define thread_global static __declspec(thread)
+#else
+#define thread_global static __thread
+#endif
+
+#if defined(_MSC_VER)
+#define CACHE_ALIGN __declspec(align(64))
+#else
+#define CACHE_ALIGN __attribute__((aligned(64)))
+#endif
 
 typedef unsigned char u8;
 typedef unsigned short u16;
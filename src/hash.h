@@ -0,0 +1,81 @@
+#ifndef HASH_H
+
+// Fast 64-bit hash for frame buffers and game state, built like XXH64: four
+// independent lanes keep the multiplies pipelined over 32-byte stripes. Only
+// meant for detecting change, not for anything adversarial.
+
+#include <string.h>
+
+#include "defines.h"
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+
+internal u64 hash_rotl(u64 value, u32 bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+internal u64 hash_read_u64(const u8 *bytes) {
+    u64 result;
+    memcpy(&result, bytes, sizeof(result));
+    return result;
+}
+
+internal u64 hash_round(u64 acc, u64 input) {
+    acc += input * HASH_PRIME_2;
+    return hash_rotl(acc, 31) * HASH_PRIME_1;
+}
+
+internal u64 hash_merge(u64 acc, u64 lane) {
+    acc ^= hash_round(0, lane);
+    return acc * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+internal u64 hash64(const void *data, u64 size, u64 seed) {
+    const u8 *bytes = (const u8 *)data;
+    const u8 *end = bytes + size;
+    u64 result;
+
+    if (size >= 32) {
+        u64 lane1 = seed + HASH_PRIME_1 + HASH_PRIME_2;
+        u64 lane2 = seed + HASH_PRIME_2;
+        u64 lane3 = seed;
+        u64 lane4 = seed - HASH_PRIME_1;
+        for (; bytes + 32 <= end; bytes += 32) {
+            lane1 = hash_round(lane1, hash_read_u64(bytes));
+            lane2 = hash_round(lane2, hash_read_u64(bytes + 8));
+            lane3 = hash_round(lane3, hash_read_u64(bytes + 16));
+            lane4 = hash_round(lane4, hash_read_u64(bytes + 24));
+        }
+        result = hash_rotl(lane1, 1) + hash_rotl(lane2, 7) +
+                 hash_rotl(lane3, 12) + hash_rotl(lane4, 18);
+        result = hash_merge(result, lane1);
+        result = hash_merge(result, lane2);
+        result = hash_merge(result, lane3);
+        result = hash_merge(result, lane4);
+    } else {
+        result = seed + HASH_PRIME_4;
+    }
+    result += size;
+
+    for (; bytes + 8 <= end; bytes += 8) {
+        result ^= hash_round(0, hash_read_u64(bytes));
+        result = hash_rotl(result, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    for (; bytes < end; bytes++) {
+        result ^= *bytes * HASH_PRIME_4;
+        result = hash_rotl(result, 11) * HASH_PRIME_1;
+    }
+
+    result ^= result >> 33;
+    result *= HASH_PRIME_2;
+    result ^= result >> 29;
+    result *= HASH_PRIME_3;
+    result ^= result >> 32;
+    return result;
+}
+
+#define HASH_H
+#endif
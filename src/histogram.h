@@ -0,0 +1,73 @@
+#ifndef HISTOGRAM_H
+
+// Log-bucketed histogram in the style of HdrHistogram: every power of two is
+// split into HISTOGRAM_SUB_COUNT linear buckets, so any recorded value is
+// known to within about 3% while the whole range up to 2^40 (18 minutes in
+// nanoseconds) fits in a few kilobytes. Recording is a couple of shifts and
+// an increment.
+
+#include "defines.h"
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKET_COUNT \
+    ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct {
+    u32 counts[HISTOGRAM_BUCKET_COUNT];
+    u64 count;
+    u64 total;
+    u64 max;
+} Histogram;
+
+internal u32 get_histogram_bucket(u64 value) {
+    u32 shift = 0;
+    while ((value >> shift) >= 2 * HISTOGRAM_SUB_COUNT) {
+        shift++;
+    }
+    u32 index = (value >> shift) < HISTOGRAM_SUB_COUNT
+                    ? (u32)value
+                    : shift * HISTOGRAM_SUB_COUNT + (u32)(value >> shift);
+    return index < HISTOGRAM_BUCKET_COUNT ? index : HISTOGRAM_BUCKET_COUNT - 1;
+}
+
+// Largest value that lands in the bucket.
+internal u64 get_histogram_bucket_limit(u32 index) {
+    if (index < 2 * HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+    u32 shift = index / HISTOGRAM_SUB_COUNT - 1;
+    u64 mantissa = index % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+internal void record_histogram(Histogram *histogram, u64 value) {
+    histogram->counts[get_histogram_bucket(value)]++;
+    histogram->count++;
+    histogram->total += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+// Smallest bucket limit that at least `percentile` percent of the values are
+// below, capped at the exact maximum.
+internal u64 get_histogram_percentile(Histogram *histogram, f64 percentile) {
+    u64 target = (u64)(percentile / 100.0 * (f64)histogram->count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    u64 seen = 0;
+    for (u32 i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        seen += histogram->counts[i];
+        if (seen >= target) {
+            u64 limit = get_histogram_bucket_limit(i);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+#define HISTOGRAM_H
+#endif
@@ -0,0 +1,228 @@
+#ifndef HISTORY_H
+
+// The last stretch of a simulation's states, one per tick, in a fixed amount
+// of memory. Every keyframe_interval ticks a state is stored whole; the ticks
+// in between store what changed since the tick before, XORed and packed in
+// pack_zero_runs()'s format, which for a game that moves a few actors a tick
+// is tens of bytes. Reading a tick unpacks the keyframe before it and applies
+// the deltas up to it. Once the memory is full the oldest ticks are dropped,
+// up to the next keyframe so that every tick kept can still be read.
+
+#include <string.h>
+
+#include "arena.h"
+#include "defines.h"
+#include "replay.h"
+
+typedef struct {
+    u32 offset;
+    u32 size;
+    b32 keyframe;
+} HistoryEntry;
+
+typedef struct {
+    u32 state_size;
+    u32 keyframe_interval;
+    // Packed states and deltas, written in a ring.
+    u8 *bytes;
+    u32 byte_capacity;
+    u32 head;
+    // One per tick, also a ring.
+    HistoryEntry *entries;
+    u32 entry_capacity;
+    u32 first;
+    u32 count;
+    u64 first_tick;
+    u32 ticks_since_keyframe;
+    // The newest state, which the next delta is taken against.
+    u8 *last;
+} History;
+
+// Splits `budget` bytes between the index and the packed data. Returns 0 when
+// the budget doesn't hold a few whole states.
+internal b32 init_history(History *history, Arena *arena, u64 budget,
+                          u32 state_size, u32 keyframe_interval) {
+    *history = (History){0};
+    u64 worst_case = 2 * (u64)state_size + 16;
+    u64 entry_capacity = budget / 64;
+    u64 index_size = entry_capacity * sizeof(HistoryEntry);
+    u64 scratch_size = state_size;
+    if (budget < index_size + scratch_size + 4 * worst_case ||
+        budget - index_size - scratch_size > 0xFFFFFFFF) {
+        return 0;
+    }
+    history->state_size = state_size;
+    history->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+    history->entry_capacity = (u32)entry_capacity;
+    history->byte_capacity = (u32)(budget - index_size - scratch_size);
+    history->entries = push_array(arena, HistoryEntry, entry_capacity);
+    history->bytes = push_array(arena, u8, history->byte_capacity);
+    history->last = push_array(arena, u8, state_size);
+    return history->entries && history->bytes && history->last;
+}
+
+// The tick after the newest one kept.
+internal u64 get_history_end(History *history) {
+    return history->first_tick + history->count;
+}
+
+internal HistoryEntry *get_history_entry(History *history, u64 tick) {
+    u32 index = (u32)(tick - history->first_tick);
+    return &history->entries[(history->first + index) %
+                             history->entry_capacity];
+}
+
+// Compares up to a word at `offset`, returns how many bytes it covered.
+internal u32 compare_history_word(const u8 *a, const u8 *b, u32 offset,
+                                  u32 size, b32 *equal) {
+    if (size - offset >= 8) {
+        u64 x, y;
+        memcpy(&x, a + offset, 8);
+        memcpy(&y, b + offset, 8);
+        *equal = x == y;
+        return 8;
+    }
+    *equal = memcmp(a + offset, b + offset, size - offset) == 0;
+    return size - offset;
+}
+
+// Packs `state` XOR `last` the way pack_zero_runs() would, but a word at a
+// time: most of a tick's state is what it was the tick before, and skipping
+// it eight bytes a step is what keeps recording every tick cheap. A changed
+// word goes out whole, zero bytes and all.
+internal u32 pack_history_delta(const u8 *state, const u8 *last, u32 size,
+                                u8 *dst) {
+    u32 packed = 0;
+    u32 i = 0;
+    while (i < size) {
+        b32 equal = 1;
+        u32 zero_start = i;
+        while (i < size) {
+            u32 step = compare_history_word(state, last, i, size, &equal);
+            if (!equal) {
+                break;
+            }
+            i += step;
+        }
+        u32 literal_start = i;
+        while (i < size) {
+            u32 step = compare_history_word(state, last, i, size, &equal);
+            if (equal) {
+                break;
+            }
+            i += step;
+        }
+        packed += put_varint(dst + packed, literal_start - zero_start);
+        packed += put_varint(dst + packed, i - literal_start);
+        for (u32 j = literal_start; j < i; j++) {
+            dst[packed++] = state[j] ^ last[j];
+        }
+    }
+    return packed;
+}
+
+internal void drop_oldest_history(History *history) {
+    do {
+        history->first = (history->first + 1) % history->entry_capacity;
+        history->first_tick++;
+        history->count--;
+    } while (history->count && !history->entries[history->first].keyframe);
+}
+
+// Stores the state of the tick after the newest one kept.
+internal void record_history(History *history, const void *state) {
+    if (!history->bytes) {
+        return;
+    }
+    b32 keyframe = history->count == 0 ||
+                   history->ticks_since_keyframe >= history->keyframe_interval;
+
+    // Room for the worst case, in one piece.
+    u32 needed = 2 * history->state_size + 16;
+    if (history->head + needed > history->byte_capacity) {
+        history->head = 0;
+    }
+    while (history->count) {
+        HistoryEntry *oldest = &history->entries[history->first];
+        if (oldest->offset + oldest->size <= history->head ||
+            oldest->offset >= history->head + needed) {
+            break;
+        }
+        drop_oldest_history(history);
+    }
+    if (history->count == history->entry_capacity) {
+        drop_oldest_history(history);
+    }
+    if (history->count == 0) {
+        // What's left to diff against went with the dropped ticks.
+        keyframe = 1;
+    }
+
+    HistoryEntry *entry = &history->entries[(history->first + history->count) %
+                                            history->entry_capacity];
+    u8 *dst = history->bytes + history->head;
+    entry->offset = history->head;
+    entry->size =
+        keyframe ? pack_zero_runs((const u8 *)state, history->state_size, dst)
+                 : pack_history_delta((const u8 *)state, history->last,
+                                      history->state_size, dst);
+    entry->keyframe = keyframe;
+    history->head += entry->size;
+    history->count++;
+    history->ticks_since_keyframe =
+        keyframe ? 1 : history->ticks_since_keyframe + 1;
+    memcpy(history->last, state, history->state_size);
+}
+
+// Fills `state` with a kept tick's. Returns 0 for a tick that isn't kept.
+internal b32 read_history(History *history, u64 tick, void *state) {
+    if (tick < history->first_tick || tick >= get_history_end(history)) {
+        return 0;
+    }
+    u64 keyframe_tick = tick;
+    while (!get_history_entry(history, keyframe_tick)->keyframe) {
+        keyframe_tick--;
+    }
+    HistoryEntry *entry = get_history_entry(history, keyframe_tick);
+    if (!unpack_zero_runs(history->bytes + entry->offset, entry->size,
+                          (u8 *)state, history->state_size)) {
+        return 0;
+    }
+    for (u64 i = keyframe_tick + 1; i <= tick; i++) {
+        entry = get_history_entry(history, i);
+        if (!xor_zero_runs(history->bytes + entry->offset, entry->size,
+                           (u8 *)state, history->state_size)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Forgets the ticks after `tick`, so the next one recorded follows it.
+internal void truncate_history(History *history, u64 tick) {
+    if (tick < history->first_tick || tick >= get_history_end(history) ||
+        !read_history(history, tick, history->last)) {
+        return;
+    }
+    history->count = (u32)(tick - history->first_tick) + 1;
+    HistoryEntry *entry = get_history_entry(history, tick);
+    history->head = entry->offset + entry->size;
+    history->ticks_since_keyframe = 1;
+    while (!entry->keyframe) {
+        history->ticks_since_keyframe++;
+        entry = get_history_entry(history, --tick);
+    }
+}
+
+// Bytes in use, for the log.
+internal u64 get_history_size(History *history) {
+    u64 size = 0;
+    for (u64 tick = history->first_tick; tick < get_history_end(history);
+         tick++) {
+        size += get_history_entry(history, tick)->size;
+    }
+    return size;
+}
+
+#define HISTORY_H
+#endif
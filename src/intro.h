@@ -0,0 +1,256 @@
+#ifndef INTRO_H
+
+// The attract sequence as a timeline of keyframes, each a text or sprite that
+// appears on a given intro tick and stays until the intro ends. The game keeps
+// a cursor into it, so a frame only walks the keys that are already shown.
+// The built-in timeline is the classic character roll call; --intro <file>
+// swaps in another one, see load_intro_timeline() for the format.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "defines.h"
+#include "hash.h"
+#include "replay.h"
+
+#define INTRO_KEY_CAPACITY 64
+#define INTRO_TEXT_CAPACITY 32
+#define INTRO_PATH_CAPACITY 256
+
+typedef enum { INTRO_TEXT, INTRO_SPRITE } IntroKeyKind;
+
+typedef enum {
+    // Drawn with the screen's fade alpha.
+    INTRO_FADE = 1 << 0,
+    // Only drawn on the visible half of the prompt blink.
+    INTRO_BLINK = 1 << 1,
+} IntroKeyFlag;
+
+typedef struct {
+    // First intro tick the key is shown on, keys are sorted by it.
+    u32 tick;
+    u8 kind;
+    u8 flags;
+    // Glyph size for text, sprite tile index (row * 14 + column) for
+    // sprites.
+    u16 value;
+    v2 pos;
+    Color color;
+    char text[INTRO_TEXT_CAPACITY];
+} IntroKey;
+
+typedef struct {
+    IntroKey keys[INTRO_KEY_CAPACITY];
+    u32 count;
+    // Intro tick the sequence starts over on, or 0 to hold the last key.
+    u32 loop_tick;
+    // Played instead of starting over when loaded.
+    Replay demo;
+    // Of the file and the demo, 0 for the built-in timeline. The intro is
+    // part of the simulation, so replays note it and only play back with
+    // the same one.
+    u64 hash;
+} IntroTimeline;
+
+#define INTRO_T(x) ((x) * 8.0f)
+#define INTRO_WHITE {255, 255, 255, 255}
+#define INTRO_RED {255, 0, 0, 255}
+#define INTRO_PINK {252, 181, 255, 255}
+#define INTRO_CYAN {0, 255, 255, 255}
+#define INTRO_ORANGE {248, 187, 85, 255}
+
+global IntroTimeline intro_timeline = {
+    {
+        {0, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(4), INTRO_T(1)}, INTRO_WHITE,
+         "1UP"},
+        {0, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(23), INTRO_T(1)}, INTRO_WHITE,
+         "2UP"},
+        {0, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(8), INTRO_T(6)}, INTRO_WHITE,
+         "CHARACTER / NICKNAME"},
+        {0, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(4), INTRO_T(36)}, INTRO_WHITE,
+         "CREDIT  0"},
+        {61, INTRO_SPRITE, INTRO_FADE, 4 * 14, {INTRO_T(5), INTRO_T(8)},
+         INTRO_WHITE, ""},
+        {121, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(8), INTRO_T(8.5f)},
+         INTRO_RED, "-SHADOW"},
+        {151, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(18), INTRO_T(8.5f)},
+         INTRO_RED, "BLINKY"},
+        {211, INTRO_SPRITE, INTRO_FADE, 5 * 14, {INTRO_T(5), INTRO_T(11)},
+         INTRO_WHITE, ""},
+        {271, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(8), INTRO_T(11.5f)},
+         INTRO_PINK, "-SPEEDY"},
+        {301, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(18), INTRO_T(11.5f)},
+         INTRO_PINK, "PINKY"},
+        {361, INTRO_SPRITE, INTRO_FADE, 6 * 14, {INTRO_T(5), INTRO_T(14)},
+         INTRO_WHITE, ""},
+        {421, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(8), INTRO_T(14.5f)},
+         INTRO_CYAN, "-BASHFUL"},
+        {451, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(18), INTRO_T(14.5f)},
+         INTRO_CYAN, "INKY"},
+        {511, INTRO_SPRITE, INTRO_FADE, 7 * 14, {INTRO_T(5), INTRO_T(17)},
+         INTRO_WHITE, ""},
+        {571, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(8), INTRO_T(17.5f)},
+         INTRO_ORANGE, "-POKEY"},
+        {601, INTRO_TEXT, INTRO_FADE, 8, {INTRO_T(18), INTRO_T(17.5f)},
+         INTRO_ORANGE, "CLYDE"},
+        {661, INTRO_SPRITE, INTRO_FADE, 3 * 14 + 1,
+         {INTRO_T(11), INTRO_T(25)}, INTRO_WHITE, ""},
+        {661, INTRO_TEXT, 0, 8, {INTRO_T(13.5f), INTRO_T(25.5f)}, INTRO_WHITE,
+         "10"},
+        {661, INTRO_TEXT, 0, 6, {INTRO_T(16.5f), INTRO_T(25.5f) + 2},
+         INTRO_WHITE, "PTS"},
+        {661, INTRO_SPRITE, INTRO_FADE, 3 * 14 + 2,
+         {INTRO_T(11), INTRO_T(27)}, INTRO_WHITE, ""},
+        {661, INTRO_TEXT, 0, 8, {INTRO_T(13.5f), INTRO_T(27.5f)}, INTRO_WHITE,
+         "50"},
+        {661, INTRO_TEXT, 0, 6, {INTRO_T(16.5f), INTRO_T(27.5f) + 2},
+         INTRO_WHITE, "PTS"},
+        {721, INTRO_TEXT, INTRO_FADE | INTRO_BLINK, 8,
+         {INTRO_T(4), INTRO_T(32)}, INTRO_PINK, "PRESS ANY KEY TO START!"},
+    },
+    23,
+    0,
+    {0},
+    0,
+};
+
+internal b32 parse_intro_flags(const char *text, u8 *flags) {
+    *flags = 0;
+    if (strcmp(text, "-") == 0) {
+        return 1;
+    }
+    while (*text) {
+        if (strncmp(text, "fade", 4) == 0) {
+            *flags |= INTRO_FADE;
+            text += 4;
+        } else if (strncmp(text, "blink", 5) == 0) {
+            *flags |= INTRO_BLINK;
+            text += 5;
+        } else {
+            return 0;
+        }
+        if (*text == ',') {
+            text++;
+        }
+    }
+    return 1;
+}
+
+// One directive per line, '#' starts a comment. Positions are in tiles and
+// colors are RRGGBB; flags are "fade", "blink", both joined by ',', or '-'
+// for none:
+//
+//     text TICK X Y SIZE COLOR FLAGS STRING...
+//     sprite TICK X Y TILE_INDEX FLAGS
+//     loop TICK
+//     demo REPLAY
+//
+// Keys have to be listed in tick order. The timeline is left untouched when
+// the file doesn't parse. The demo replay is pushed on `arena`.
+internal b32 load_intro_timeline(const char *path, IntroTimeline *timeline,
+                                 Arena *arena) {
+    char *data = LoadFileText(path);
+    if (!data) {
+        return 0;
+    }
+    u64 hash = hash64(data, strlen(data), 0);
+
+    TempMemory temp = begin_temp_memory(arena);
+    IntroTimeline *result = push_struct(arena, IntroTimeline);
+    char demo_path[INTRO_PATH_CAPACITY] = {0};
+    u32 line_number = 0;
+    b32 ok = 1;
+    char *next = 0;
+    for (char *line = data; line && ok; line = next) {
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = 0;
+        }
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = 0;
+        }
+
+        char directive[16] = {0};
+        i32 consumed = 0;
+        if (sscanf(line, " %15s %n", directive, &consumed) != 1) {
+            continue;
+        }
+        char *args = line + consumed;
+
+        if (strcmp(directive, "loop") == 0) {
+            ok = sscanf(args, "%u", &result->loop_tick) == 1;
+        } else if (strcmp(directive, "demo") == 0) {
+            ok = sscanf(args, "%255s", demo_path) == 1;
+        } else if (strcmp(directive, "text") == 0 ||
+                   strcmp(directive, "sprite") == 0) {
+            if (result->count == INTRO_KEY_CAPACITY) {
+                TraceLog(LOG_WARNING, "INTRO: [%s] More than %d keys", path,
+                         INTRO_KEY_CAPACITY);
+                ok = 0;
+                continue;
+            }
+            IntroKey *key = &result->keys[result->count];
+            char flags[32] = {0};
+            f32 x = 0;
+            f32 y = 0;
+            u32 value = 0;
+            u32 color = 0xFFFFFF;
+            if (directive[0] == 't') {
+                key->kind = INTRO_TEXT;
+                ok = sscanf(args, "%u %f %f %u %x %31s %n", &key->tick, &x,
+                            &y, &value, &color, flags, &consumed) == 6;
+                if (ok) {
+                    char *text = args + consumed;
+                    u32 length = (u32)strcspn(text, "\r");
+                    ok = length > 0 && length < INTRO_TEXT_CAPACITY;
+                    if (ok) {
+                        memcpy(key->text, text, length);
+                    }
+                }
+            } else {
+                key->kind = INTRO_SPRITE;
+                ok = sscanf(args, "%u %f %f %u %31s", &key->tick, &x, &y,
+                            &value, flags) == 5;
+            }
+            ok = ok && parse_intro_flags(flags, &key->flags) &&
+                 (result->count == 0 ||
+                  key->tick >= result->keys[result->count - 1].tick);
+            key->value = (u16)value;
+            key->pos = (v2){INTRO_T(x), INTRO_T(y)};
+            key->color = (Color){(u8)(color >> 16), (u8)(color >> 8),
+                                 (u8)color, 255};
+            result->count++;
+        } else {
+            ok = 0;
+        }
+    }
+    UnloadFileText(data);
+
+    if (!ok) {
+        TraceLog(LOG_WARNING, "INTRO: [%s] Line %u doesn't parse", path,
+                 line_number);
+    } else if (demo_path[0] &&
+               !load_replay(demo_path, &result->demo, arena)) {
+        ok = 0;
+    }
+    if (ok) {
+        Replay *demo = &result->demo;
+        result->hash =
+            hash64(demo->inputs, demo->tick_count, hash ^ demo->seed);
+        if (!result->hash) {
+            result->hash = 1;
+        }
+        *timeline = *result;
+        TraceLog(LOG_INFO, "INTRO: [%s] %u keys loaded", path,
+                 timeline->count);
+    } else {
+        end_temp_memory(temp);
+    }
+    return ok;
+}
+
+#define INTRO_H
+#endif
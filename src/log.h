@@ -0,0 +1,434 @@
+#ifndef LOG_H
+
+// Logging off the simulation thread. TraceLog() calls land in
+// trace_log_callback(), which copies the format pointer and the raw arguments
+// into a fixed-size record in a lock-free ring; a background thread does the
+// formatting and the writes. Formats have to be string literals, which all
+// TraceLog() formats are. Debug logging compiles out unless PACMAN_DEBUG is
+// defined, which the debug builds do.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "platform.h"
+
+#if defined(PACMAN_DEBUG)
+#define DEBUG_LOG(...) TraceLog(LOG_DEBUG, __VA_ARGS__)
+#define LOG_MIN_LEVEL LOG_DEBUG
+#else
+#define DEBUG_LOG(...) ((void)0)
+#define LOG_MIN_LEVEL LOG_INFO
+#endif
+
+#define LOG_RING_CAPACITY 4096
+#define LOG_MAX_ARGS 12
+#define LOG_STRING_CAPACITY 120
+#define LOG_LINE_CAPACITY 512
+#define LOG_IDLE_SECONDS 0.002
+
+#define ANSI_RED "\x1b[31m"
+#define ANSI_GREEN "\x1b[32m"
+#define ANSI_YELLOW "\x1b[33m"
+#define ANSI_BLUE "\x1b[34m"
+#define ANSI_MAGENTA "\x1b[35m"
+#define ANSI_CYAN "\x1b[36m"
+#define ANSI_RESET "\x1b[0m"
+
+typedef enum {
+    LOG_ARG_NONE,
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_CHAR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER,
+    LOG_ARG_PERCENT,
+} LogArgKind;
+
+// One conversion of a printf format.
+typedef struct {
+    const char *start;
+    u32 length;
+    u32 prefix_length;
+    LogArgKind kind;
+    // 0 for int-sized, 'h', 'l', 'L' (long long), 'z', 'j' or 't'.
+    char size;
+} LogSpec;
+
+typedef union {
+    i64 i;
+    u64 u;
+    f64 f;
+    const void *p;
+    // Offset into the record's strings.
+    u32 string;
+} LogArg;
+
+typedef struct {
+    // Vyukov-style slot sequence: equals the write position when the slot is
+    // free, position + 1 once the record is published.
+    volatile u32 sequence;
+    u8 level;
+    u8 to_stderr;
+    u8 arg_count;
+    u8 string_used;
+    const char *format;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_CAPACITY];
+} LogRecord;
+
+typedef struct {
+    LogRecord *records;
+    volatile u32 write_pos;
+    u32 read_pos;
+    volatile u32 running;
+    volatile u32 dropped_count;
+    Thread thread;
+} Logger;
+
+global Logger logger = {0};
+
+// Set when stdout carries data, e.g. video piped out of --export.
+global b32 log_to_stderr = 0;
+
+// Parses the conversion at `format`, which points at a '%'.
+internal const char *parse_log_spec(const char *format, LogSpec *spec) {
+    const char *c = format + 1;
+    spec->start = format;
+    spec->size = 0;
+    while (*c && strchr("-+ #0", *c)) {
+        c++;
+    }
+    while ((*c >= '0' && *c <= '9') || *c == '.') {
+        c++;
+    }
+    spec->prefix_length = (u32)(c - format);
+
+    if (c[0] == 'h') {
+        spec->size = 'h';
+        c += c[1] == 'h' ? 2 : 1;
+    } else if (c[0] == 'l') {
+        spec->size = c[1] == 'l' ? 'L' : 'l';
+        c += c[1] == 'l' ? 2 : 1;
+    } else if (*c == 'z' || *c == 'j' || *c == 't') {
+        spec->size = *c++;
+    } else if (*c == 'L') {
+        // long double is passed on as a double.
+        c++;
+    }
+
+    switch (*c) {
+        case 'd':
+        case 'i':
+            spec->kind = LOG_ARG_INT;
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec->kind = LOG_ARG_UINT;
+            break;
+        case 'c':
+            spec->kind = LOG_ARG_CHAR;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->kind = LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->kind = LOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->kind = LOG_ARG_POINTER;
+            break;
+        case '%':
+            spec->kind = LOG_ARG_PERCENT;
+            break;
+        default:
+            spec->kind = LOG_ARG_NONE;
+            break;
+    }
+    if (*c) {
+        c++;
+    }
+    spec->length = (u32)(c - format);
+    return c;
+}
+
+internal void read_log_arg(LogRecord *record, LogSpec *spec, va_list *args) {
+    LogArg *arg = &record->args[record->arg_count++];
+    switch (spec->kind) {
+        case LOG_ARG_INT:
+            switch (spec->size) {
+                case 'l': arg->i = va_arg(*args, long); break;
+                case 'L': arg->i = va_arg(*args, long long); break;
+                case 'z': arg->i = (i64)va_arg(*args, size_t); break;
+                case 'j': arg->i = va_arg(*args, long long); break;
+                case 't': arg->i = va_arg(*args, ptrdiff_t); break;
+                default: arg->i = va_arg(*args, int); break;
+            }
+            break;
+        case LOG_ARG_UINT:
+            switch (spec->size) {
+                case 'l': arg->u = va_arg(*args, unsigned long); break;
+                case 'L': arg->u = va_arg(*args, unsigned long long); break;
+                case 'z': arg->u = va_arg(*args, size_t); break;
+                case 'j': arg->u = va_arg(*args, unsigned long long); break;
+                case 't': arg->u = (u64)va_arg(*args, ptrdiff_t); break;
+                default: arg->u = va_arg(*args, unsigned int); break;
+            }
+            break;
+        case LOG_ARG_CHAR:
+            arg->i = va_arg(*args, int);
+            break;
+        case LOG_ARG_DOUBLE:
+            arg->f = va_arg(*args, double);
+            break;
+        case LOG_ARG_POINTER:
+            arg->p = va_arg(*args, void *);
+            break;
+        case LOG_ARG_STRING: {
+            // Strings are copied, they rarely outlive the call. Ones that
+            // don't fit are cut short.
+            const char *text = va_arg(*args, const char *);
+            if (!text) {
+                text = "(null)";
+            }
+            u32 available = LOG_STRING_CAPACITY - record->string_used;
+            u32 length = (u32)strlen(text);
+            if (length >= available) {
+                length = available ? available - 1 : 0;
+            }
+            arg->string = record->string_used;
+            if (available) {
+                memcpy(record->strings + record->string_used, text, length);
+                record->strings[record->string_used + length] = 0;
+                record->string_used += (u8)(length + 1);
+            } else {
+                arg->string = LOG_STRING_CAPACITY - 1;
+            }
+        } break;
+        default:
+            record->arg_count--;
+            break;
+    }
+}
+
+// Formats one conversion with the argument widened the way it was stored.
+internal i32 format_log_arg(char *out, u32 size, LogSpec *spec,
+                            LogRecord *record, LogArg *arg) {
+    char format[32];
+    u32 prefix = spec->prefix_length < 24 ? spec->prefix_length : 24;
+    memcpy(format, spec->start, prefix);
+    char conversion = spec->start[spec->length - 1];
+
+    switch (spec->kind) {
+        case LOG_ARG_INT:
+        case LOG_ARG_UINT:
+            format[prefix] = 'l';
+            format[prefix + 1] = 'l';
+            format[prefix + 2] = conversion;
+            format[prefix + 3] = 0;
+            if (spec->kind == LOG_ARG_INT) {
+                return snprintf(out, size, format, (long long)arg->i);
+            }
+            return snprintf(out, size, format, (unsigned long long)arg->u);
+        case LOG_ARG_CHAR:
+        case LOG_ARG_DOUBLE:
+        case LOG_ARG_STRING:
+        case LOG_ARG_POINTER:
+            format[prefix] = conversion;
+            format[prefix + 1] = 0;
+            if (spec->kind == LOG_ARG_CHAR) {
+                return snprintf(out, size, format, (int)arg->i);
+            } else if (spec->kind == LOG_ARG_DOUBLE) {
+                return snprintf(out, size, format, arg->f);
+            } else if (spec->kind == LOG_ARG_STRING) {
+                return snprintf(out, size, format,
+                                record->strings + arg->string);
+            }
+            return snprintf(out, size, format, arg->p);
+        default:
+            return 0;
+    }
+}
+
+internal void format_log_record(LogRecord *record, char *out, u32 size) {
+    u32 used = 0;
+    u32 arg_index = 0;
+    for (const char *c = record->format; *c && used + 1 < size;) {
+        if (*c != '%') {
+            out[used++] = *c++;
+            continue;
+        }
+        LogSpec spec;
+        c = parse_log_spec(c, &spec);
+        i32 written = 0;
+        if (spec.kind == LOG_ARG_PERCENT) {
+            out[used] = '%';
+            written = 1;
+        } else if (spec.kind != LOG_ARG_NONE && arg_index < record->arg_count) {
+            written = format_log_arg(out + used, size - used, &spec, record,
+                                     &record->args[arg_index++]);
+        }
+        if (written > 0) {
+            used += (u32)written < size - used ? (u32)written
+                                               : size - used - 1;
+        }
+    }
+    // The old printf-style callers end their debug formats in a newline.
+    while (used > 0 && out[used - 1] == '\n') {
+        used--;
+    }
+    out[used] = 0;
+}
+
+internal void write_log_line(i32 level, b32 to_stderr, const char *message) {
+    FILE *stream = to_stderr ? stderr : stdout;
+    switch (level) {
+        case LOG_INFO:
+            fprintf(stream, ANSI_CYAN "[INFO]" ANSI_RESET " %s\n", message);
+            break;
+        case LOG_WARNING:
+            fprintf(stream, ANSI_YELLOW "[WARNING]" ANSI_RESET " %s\n",
+                    message);
+            break;
+        case LOG_ERROR:
+            fprintf(stream, ANSI_RED "[ERROR]" ANSI_RESET " %s\n", message);
+            break;
+        case LOG_DEBUG:
+            fprintf(stream, ANSI_GREEN "[DEBUG]" ANSI_RESET " %s\n", message);
+            break;
+        default:
+            fprintf(stream, "%s\n", message);
+            break;
+    }
+}
+
+// Writes out every published record, returns how many there were.
+internal u32 drain_log_ring() {
+    u32 count = 0;
+    char line[LOG_LINE_CAPACITY];
+    for (;;) {
+        LogRecord *record =
+            &logger.records[logger.read_pos % LOG_RING_CAPACITY];
+        if (atomic_load_u32(&record->sequence) != logger.read_pos + 1) {
+            break;
+        }
+        format_log_record(record, line, sizeof(line));
+        write_log_line(record->level, record->to_stderr, line);
+        atomic_store_u32(&record->sequence,
+                         logger.read_pos + LOG_RING_CAPACITY);
+        logger.read_pos++;
+        count++;
+    }
+    return count;
+}
+
+internal void log_worker(void *data) {
+    (void)data;
+    while (atomic_load_u32(&logger.running)) {
+        if (drain_log_ring()) {
+            fflush(stdout);
+        } else {
+            sleep_seconds(LOG_IDLE_SECONDS);
+        }
+    }
+    drain_log_ring();
+    fflush(stdout);
+}
+
+// Claims a slot, or returns 0 when the formatter has fallen a whole ring
+// behind and the record is dropped.
+internal LogRecord *claim_log_record() {
+    u32 pos = atomic_load_u32(&logger.write_pos);
+    for (;;) {
+        LogRecord *record = &logger.records[pos % LOG_RING_CAPACITY];
+        i32 diff = (i32)(atomic_load_u32(&record->sequence) - pos);
+        if (diff == 0) {
+            if (atomic_cas_u32(&logger.write_pos, pos, pos + 1)) {
+                return record;
+            }
+        } else if (diff < 0) {
+            atomic_add_u32(&logger.dropped_count, 1);
+            return 0;
+        }
+        pos = atomic_load_u32(&logger.write_pos);
+    }
+}
+
+void trace_log_callback(int log_type, const char *text, va_list args) {
+    if (!logger.records) {
+        char message[LOG_LINE_CAPACITY];
+        vsnprintf(message, sizeof(message), text, args);
+        write_log_line(log_type, log_to_stderr, message);
+        return;
+    }
+
+    LogRecord *record = claim_log_record();
+    if (!record) {
+        return;
+    }
+    u32 pos = record->sequence;
+    record->level = (u8)log_type;
+    record->to_stderr = (u8)log_to_stderr;
+    record->arg_count = 0;
+    record->string_used = 0;
+    record->format = text;
+
+    va_list copy;
+    va_copy(copy, args);
+    for (const char *c = text; *c && record->arg_count < LOG_MAX_ARGS;) {
+        if (*c != '%') {
+            c++;
+            continue;
+        }
+        LogSpec spec;
+        c = parse_log_spec(c, &spec);
+        if (spec.kind != LOG_ARG_NONE && spec.kind != LOG_ARG_PERCENT) {
+            read_log_arg(record, &spec, &copy);
+        }
+    }
+    va_end(copy);
+
+    atomic_store_u32(&record->sequence, pos + 1);
+}
+
+internal void start_logger() {
+    logger.records =
+        (LogRecord *)MemAlloc(LOG_RING_CAPACITY * sizeof(LogRecord));
+    for (u32 i = 0; i < LOG_RING_CAPACITY; i++) {
+        logger.records[i].sequence = i;
+    }
+    logger.write_pos = 0;
+    logger.read_pos = 0;
+    logger.running = 1;
+    logger.thread = start_thread(log_worker, 0);
+}
+
+// Writes out what is still queued and goes back to logging synchronously.
+internal void stop_logger() {
+    if (!logger.records) {
+        return;
+    }
+    atomic_store_u32(&logger.running, 0);
+    join_thread(logger.thread);
+    u32 dropped_count = logger.dropped_count;
+    MemFree(logger.records);
+    logger.records = 0;
+    if (dropped_count) {
+        TraceLog(LOG_WARNING, "LOG: %u records dropped", dropped_count);
+    }
+}
+
+#define LOG_H
+#endif
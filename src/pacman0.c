@@ -1,13 +1,46 @@
+// clock_gettime() and pthreads under -std=c99.
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "defines.h"
 #include "raylib.h"
+#include "soft_render.h"
+#include "platform.h"
+#include "arena.h"
+#include "log.h"
+#include "profile.h"
+#include "histogram.h"
+#include "replay.h"
+#include "history.h"
+#include "hash.h"
+#include "atlas.h"
+#include "atlas_generated.h"
+#include "intro.h"
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SWARM_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWARM_LANES 4
+#else
+#define SWARM_LANES 1
+#endif
 
 #define TILE_WIDTH 8
-#define TILE_WIDTH_INV (1 / (f32)TILE_WIDTH)
 #define TILE_HEIGHT 8
-#define TILE_HEIGHT_INV (1 / (f32)TILE_HEIGHT)
+#define SUBPIXEL_BITS 4
+#define SUBPIXELS (1 << SUBPIXEL_BITS)
+#define SUBPX(px) ((i32)((px) * SUBPIXELS))
 #define SCREEN_TILES_X 30
 #define SCREEN_TILES_Y 38
 #define BACK_BUFFER_WIDTH (SCREEN_TILES_X * TILE_WIDTH)
@@ -19,7 +52,6 @@
 #define SPRITE_TILES_X 14
 #define SPRITE_TILES_Y 13
 #define SCALE 2.5f
-#define DISABLED_TICK 0xFFFFFFFF
 #define FPS 60
 #define TIME_PER_FRAME 1 / FPS
 #define PACMAN_TICKS_PER_ANIM_FRAME 4
@@ -27,11 +59,13 @@
 #define PACMAN_IDLE_ANIM_FRAME_COUNT 1
 #define PACMAN_MOVE_ANIM_FRAME_COUNT 4
 #define PACMAN_DIE_ANIM_FRAME_COUNT 11
-#define PACMAN_CORNERING_RANGE 3.5f
-#define GHOST_CORNERING_RANGE 2.5f
-#define COLLISION_RANGE 3.5f
+#define PACMAN_CORNERING_RANGE SUBPX(3.5)
+#define GHOST_CORNERING_RANGE SUBPX(2.5)
+#define COLLISION_RANGE SUBPX(3.5)
 // #define MAX_SPEED 75.75757625f
-#define MAX_SPEED 70.0f
+// Pixels per second at 100% speed.
+#define MAX_SPEED 70
+#define SPEED_PATTERN_TICKS 16
 #define GHOST_TICKS_PER_ANIM_FRAME 8
 #define GHOST_MOVE_ANIM_FRAME_COUNT 2
 #define GHOST_EATEN_ANIM_FRAME_COUNT 1
@@ -43,18 +77,68 @@
 #define PRESS_ANY_KEY_TICKS_PER_ANIM_FRAME 30
 #define DOT_COUNT 240
 #define PILL_COUNT 4
-#define DOOR_ENTRY_X (15 * TILE_WIDTH)
-#define DOOR_ENTRY_Y ((15 + 0.5) * TILE_HEIGHT)
-#define GHOST_HOME_CENTER_X (15 * TILE_WIDTH)
-#define GHOST_HOME_CENTER_Y ((18 + 0.5) * TILE_HEIGHT)
+#define DOT_CHANGE_CAPACITY 8
+#define DOOR_ENTRY_X SUBPX(15 * TILE_WIDTH)
+#define DOOR_ENTRY_Y SUBPX((15 + 0.5) * TILE_HEIGHT)
+#define GHOST_HOME_CENTER_X SUBPX(15 * TILE_WIDTH)
+#define GHOST_HOME_CENTER_Y SUBPX((18 + 0.5) * TILE_HEIGHT)
 #define ROUND_COUNT 3
 #define BONUS_ACTIVE_TICKS 10 * FPS
 #define BONUS_ACTIVE_TICKS 10 * FPS
 #define BONUS_POINTS_TICKS 1 * FPS
 #define FADE_TICKS 30
+#define SWARM_MAX_GHOSTS 4096
+#define SWARM_CHASE_SPREAD 8
+#define DRAW_COMMAND_CAPACITY (SWARM_MAX_GHOSTS + 1024)
+// Batched draws sample from one of the TextureIds or a cached layer.
+#define BATCH_DOTS TEXTURE_COUNT
+#define BATCH_HUD (TEXTURE_COUNT + 1)
+#define BATCH_SOURCE_COUNT (TEXTURE_COUNT + 2)
+#define HUD_TOP_HEIGHT (SCORE_TILE_ROW_COUNT * TILE_HEIGHT)
+#define HUD_BOTTOM_Y (35 * TILE_HEIGHT)
+#define DIRTY_CELL_SIZE 16
+#define DIRTY_CELLS_X (BACK_BUFFER_WIDTH / DIRTY_CELL_SIZE)
+#define DIRTY_CELLS_Y (BACK_BUFFER_HEIGHT / DIRTY_CELL_SIZE)
+#define DIRTY_CELL_COUNT (DIRTY_CELLS_X * DIRTY_CELLS_Y)
+// An unchanged frame is still presented this often, so a window uncovered
+// on a desktop without compositing gets repainted.
+#define IDLE_PRESENT_TICKS FPS
+#define PROFILE_OVERLAY_KEY KEY_F3
+#define FRAME_STATS_KEY KEY_F4
+#define HISTORY_PAUSE_KEY KEY_F5
+// Ten minutes of play take about 5 MB, so this keeps the last hour.
+#define HISTORY_DEFAULT_MB 32
+#define HISTORY_KEYFRAME_TICKS FPS
+// Ticks per frame when scrubbing with shift held.
+#define HISTORY_FAST_SCRUB_TICKS 10
+// A frame over budget by more than vsync jitter is a visible stutter.
+#define HITCH_THRESHOLD_NS (1000000000ULL / FPS * 5 / 4)
+#define HITCH_CAPACITY 64
+#define HITCH_HISTORY_FRAMES 4
+#define BENCH_MIN_SECONDS 0.05
+#define BENCH_REPEATS 5
+#define BENCH_THRESHOLD_PERCENT 10.0
+#define DEFAULT_SEED 0x12345678
+// The tuning stops changing after level 21.
+#define LEVEL_TUNING_COUNT 21
+// Reservations only, pages are committed as the arenas fill up.
+#define PERMANENT_ARENA_SIZE (1024ULL * 1024 * 1024)
+// Per verify thread, for the replay it is on.
+#define VERIFY_ARENA_SIZE (256ULL * 1024 * 1024)
+#define EXPORT_WIDTH (BACK_BUFFER_WIDTH - 2 * TILE_WIDTH)
+#define EXPORT_HEIGHT (BACK_BUFFER_HEIGHT - 2 * TILE_HEIGHT)
 
 typedef enum { DIR_UP, DIR_LEFT, DIR_DOWN, DIR_RIGHT, DIR_COUNT } Direction;
 
+// One bit per held direction, plus START for any key pressed this tick.
+typedef enum {
+    INPUT_UP = 1 << DIR_UP,
+    INPUT_LEFT = 1 << DIR_LEFT,
+    INPUT_DOWN = 1 << DIR_DOWN,
+    INPUT_RIGHT = 1 << DIR_RIGHT,
+    INPUT_START = 1 << DIR_COUNT
+} InputFlag;
+
 typedef enum { TILE_EMPTY, TILE_WALL, TILE_DOT, TILE_PILL, TILE_DOOR } TileType;
 
 typedef enum {
@@ -96,9 +180,13 @@ typedef enum {
     GHOST_EYES,
     GHOST_ENTER_HOME,
     GHOST_HOME,
-    GHOST_LEAVE_HOME
+    GHOST_LEAVE_HOME,
+    GHOST_STATE_COUNT
 } GhostState;
 
+// How far Blinky has sped up as the maze empties.
+typedef enum { ELROY_NONE, ELROY_1, ELROY_2, ELROY_COUNT } ElroyLevel;
+
 typedef enum {
     GAME_INTRO,
     GAME_LOAD,
@@ -130,6 +218,14 @@ typedef enum {
     GHOST_ANIM_TYPE_COUNT
 } GhostAnimType;
 
+typedef enum { RENDER_GPU, RENDER_SOFTWARE } RenderBackend;
+
+typedef enum { TEXTURE_ATLAS, TEXTURE_COUNT } TextureId;
+
+// Draws are only reordered within a layer, so anything that has to stay on
+// top of something drawn from another texture goes in a higher layer.
+typedef enum { LAYER_MAZE, LAYER_HUD, LAYER_ACTORS, LAYER_COUNT } DrawLayer;
+
 typedef enum {
     PACMAN_IDLING,
     PACMAN_GOING_LEFT,
@@ -140,13 +236,15 @@ typedef enum {
     PACMAN_ANIM_TYPE_COUNT
 } PacManAnimType;
 
+// A tick something happens on, once scheduled with after(). Ticks are 64-bit
+// so a headless run at millions of ticks a second never wraps them.
 typedef struct {
-    u32 tick;
+    u64 tick;
+    b32 scheduled;
 } Event;
 
 typedef struct {
     BonusType type;
-    BonusState state;
     Rectangle bonus_tile;
     Rectangle points_tile;
     u32 points;
@@ -160,13 +258,21 @@ typedef struct {
     u32 frame_index;
 } Animation;
 
+// Sub-pixels moved on each tick of a SPEED_PATTERN_TICKS cycle, spread out
+// evenly like the arcade's speed bit patterns.
 typedef struct {
-    v2 pos;
-    v2 vel;
+    u8 steps[SPEED_PATTERN_TICKS];
+} SpeedPattern;
+
+typedef struct {
+    // Position in sub-pixels, SUBPIXELS per pixel.
+    v2i pos;
+    // Points into the level's speed tables.
+    SpeedPattern *speed;
     v2 half_dim;
     Direction dir;
     b32 can_turn;
-    f32 cornering_range;
+    i32 cornering_range;
 } Actor;
 
 typedef struct {
@@ -175,8 +281,6 @@ typedef struct {
     PacManState state;
     PacManAnimType anim_type;
     v2i tile;
-    u32 anim_frame_counts[PACMAN_ANIM_TYPE_COUNT];
-    u32 anim_indexes_in_sprite[PACMAN_ANIM_TYPE_COUNT];
 } PacMan;
 
 typedef struct {
@@ -187,42 +291,61 @@ typedef struct {
     GhostAnimType anim_type;
     Event eaten;
     Event turned_to_eyes;
-    u32 anim_frame_counts[GHOST_ANIM_TYPE_COUNT];
-    u32 anim_indexes_in_sprite[GHOST_ANIM_TYPE_COUNT];
 } Ghost;
 
+// Tuning for one level. Only read during a tick, see `levels`.
 typedef struct {
     Bonus bonus;
-    f32 pacman_speed;
-    f32 pacman_dots_speed;
-    f32 pacman_panic_speed;
-    f32 pacman_panic_dots_speed;
-    f32 ghost_speed;
-    f32 ghost_home_speed;
-    f32 ghost_eyes_speed;
-    f32 ghost_tunnel_speed;
-    f32 ghost_panic_speed;
+    SpeedPattern pacman_speed;
+    SpeedPattern pacman_dots_speed;
+    SpeedPattern pacman_panic_speed;
+    SpeedPattern pacman_panic_dots_speed;
+    SpeedPattern ghost_speed;
+    SpeedPattern ghost_home_speed;
+    SpeedPattern ghost_eyes_speed;
+    SpeedPattern ghost_tunnel_speed;
+    SpeedPattern ghost_panic_speed;
     u32 elroy1_dots_left;
-    f32 elroy1_speed;
+    SpeedPattern elroy1_speed;
     u32 elroy2_dots_left;
-    f32 elroy2_speed;
+    SpeedPattern elroy2_speed;
     u32 ghost_panic_ticks;
     u32 ghost_flash_count;
     u32 inky_dot_limit;
     u32 clyde_dot_limit;
+    // The speeds above by what picks them, built by build_speed_tables(), so
+    // choosing an actor's speed is one indexed load. Ghosts are indexed by
+    // state, in the tunnel or not and ElroyLevel (only ever set for Blinky),
+    // Pac-Man by speeding after a pill or not and on a dot or pill or not.
+    SpeedPattern *ghost_speeds[GHOST_STATE_COUNT][2][ELROY_COUNT];
+    SpeedPattern *pacman_speeds[2][2];
 } Level;
 
+// Dot tiles eaten since the renderer last synced its dot layer. Refilling
+// the maze, or eating more than fits here, asks for a full redraw instead.
+typedef struct {
+    v2i tiles[DOT_CHANGE_CAPACITY];
+    u32 count;
+    b32 refilled;
+} DotChanges;
+
+// Everything a tick reads and writes, and nothing it doesn't: audio handles
+// are in `audio`, level tuning in `levels` and animation tables in globals,
+// so the whole simulation state is about a kilobyte and a copy of it is a
+// snapshot.
 typedef struct {
     GameState state;
     PacMan pacman;
     Ghost ghosts[GHOST_TYPE_COUNT];
-    Sound chomp_sfx;
-    Sound death_sfx;
-    Sound bonus_sfx;
-    Sound ghost_eat_sfx;
-    Music siren_bgm;
-    Music power_pellet_bgm;
-    Level level;
+    Animation pill_anim;
+    Animation maze_anim;
+    Animation press_any_key_anim;
+    f32 alpha;
+    u8 input;
+    DotChanges dot_changes;
+    // Points into `levels`.
+    Level *level;
+    BonusState bonus_state;
     Event load;
     Event prelude;
     Event ready;
@@ -238,26 +361,250 @@ typedef struct {
     Event bonus_timeup;
     Event bonus_collected;
     Event bonus_point_hide;
-    u32 tick;
+    u64 tick;
     u32 score;
     u32 high_score;
     i32 rounds_left;
     u32 level_count;
     u32 dots_left;
     u32 pills_left;
+    // Which dots and pills are gone, a bit of hash per eaten tile, so the
+    // state hash doesn't have to walk the tile map.
+    u64 eaten_tiles_hash;
     u32 ghost_eaten_count;
     u32 xorshift;
+    // Intro timeline keys shown so far.
+    u32 intro_cursor;
+    b32 intro_blinking;
+    b32 demo_active;
+    u32 demo_tick;
+    u32 demo_high_score;
 } Game;
 
-global Game game = {0};
+// The game-wide values the ghosts and the swarm act on, worked out once per
+// tick by prepare_tick() after Pac-Man has moved. Actor updates only read it.
+typedef struct {
+    Level *level;
+    v2i pacman_pos;
+    v2i pacman_tile;
+    Direction pacman_dir;
+    // Inky aims off where Blinky is after this tick's move, so Blinky is
+    // updated first and this is refreshed before the others.
+    v2i blinky_tile;
+    u32 dots_eaten;
+    // Scatter or chase, from the time since play started.
+    GhostState schedule_state;
+    // Blinky's Elroy level, from the dots left.
+    ElroyLevel elroy;
+    // A pill was eaten this tick, the ghosts panic until `recover`.
+    b32 pill_chomped;
+    Event start_recovery;
+    Event recover;
+    b32 recovery_started;
+    b32 panic_over;
+    // The swarm's view: between the pill and the recovery.
+    b32 panicking;
+} TickContext;
+
+typedef struct {
+    Sound prelude_sfx;
+    Sound chomp_sfx;
+    Sound death_sfx;
+    Sound bonus_sfx;
+    Sound ghost_eat_sfx;
+    Music siren_bgm;
+    Music power_pellet_bgm;
+} Audio;
+
+// Structure-of-arrays ghost population for swarm mode. Every array holds
+// `capacity` entries (count rounded up to SWARM_LANES) and is 64-byte aligned
+// so the steering kernel can run over whole lanes without a scalar tail.
+typedef struct {
+    u32 count;
+    u32 capacity;
+    i32 *pos_x;
+    i32 *pos_y;
+    i32 *speed_offset;
+    f32 *scatter_x;
+    f32 *scatter_y;
+    f32 *chase_offset_x;
+    f32 *chase_offset_y;
+    i32 *dir;
+    i32 *state;
+    i32 *last_tile;
+    u32 *rng;
+    u8 *type;
+    i32 exits[SCREEN_TILES_X * SCREEN_TILES_Y];
+    i32 spawn_tiles[SCREEN_TILES_X * SCREEN_TILES_Y];
+    u32 spawn_tile_count;
+    f64 update_time_total;
+    u32 update_count;
+} Swarm;
+
+typedef struct {
+    u8 layer;
+    u8 source;
+    Rectangle rec;
+    v2 pos;
+    Color tint;
+} DrawCommand;
+
+// Draws collected over a frame. Flushing sorts them by layer and source with
+// a stable counting sort, so each source is bound once per layer and raylib
+// can submit every run as a single draw call.
+typedef struct {
+    DrawCommand *commands;
+    DrawCommand *sorted;
+    u32 count;
+    DrawLayer layer;
+    u64 run_total;
+    u32 frame_count;
+} SpriteBatch;
+
+// The back buffer is kept between frames. Each cell of it gets a signature of
+// the draws that touch it, in order, and only the cells whose signature
+// changed since the last frame are cleared and redrawn. The cached layers
+// carry a version so that redrawing one changes the signature of its draws.
+typedef struct {
+    b32 valid;
+    b32 composing;
+    u64 cells[DIRTY_CELL_COUNT];
+    SoftRect rects[DIRTY_CELL_COUNT];
+    u32 rect_count;
+    // Screen bounds of each sorted draw.
+    SoftRect *bounds;
+    u64 dot_version;
+    u64 hud_version;
+    u32 unchanged_frames;
+    u64 dirty_pixel_total;
+} Compositor;
+
+// What the cached HUD layer was last drawn with.
+typedef struct {
+    b32 valid;
+    b32 main_screen;
+    u32 score;
+    u32 high_score;
+    i32 rounds_left;
+    u32 fruit_count;
+} HudState;
+
+// Everything the back buffer is drawn with. The GPU backend renders into
+// back_buffer through raylib, the software backend rasterizes into frame and
+// only uploads it to frame_tex for presenting. Dots live in their own layer
+// that is only touched when one is eaten; pills animate, so they are drawn
+// every frame from pill_tiles. The scores, lives and level fruit are kept in
+// the HUD layer and only redrawn when hud_state changes.
+typedef struct {
+    RenderBackend backend;
+    Texture2D textures[TEXTURE_COUNT];
+    RenderTexture2D back_buffer;
+    RenderTexture2D dot_layer;
+    RenderTexture2D hud_layer;
+    SoftImage images[TEXTURE_COUNT];
+    SoftImage frame;
+    SoftImage soft_dot_layer;
+    SoftImage soft_hud_layer;
+    // Where the software backend's batch is flushed to.
+    SoftImage *target;
+    b32 back_buffer_bound;
+    v2i pill_tiles[PILL_COUNT];
+    u32 pill_tile_count;
+    HudState hud_state;
+    SpriteBatch batch;
+    Compositor compositor;
+    u32 idle_tick_count;
+    u32 tick_count;
+    Texture2D frame_tex;
+    f64 frame_start_time;
+    f64 soft_time_total;
+    u32 soft_frame_count;
+} Renderer;
+
+// The recent past of the game, kept for stepping back through it. While
+// paused, the game shows the kept tick at `cursor` and nothing is simulated.
+typedef struct {
+    History history;
+    b32 paused;
+    u64 cursor;
+} TimeTravel;
+
+thread_global CACHE_ALIGN Game game = {0};
+global Audio audio = {0};
+// Levels past the last entry play like it. Filled in once by load_levels() at
+// startup and only read after that.
+global Level levels[LEVEL_TUNING_COUNT] = {0};
+global Swarm swarm = {0};
+global Renderer renderer = {0};
+global TimeTravel time_travel = {0};
+// Lives until exit: tables, render batches, loaded replays. Sessions and
+// levels don't allocate, they start over on what is already there.
+global Arena permanent_arena = {0};
 global v2i dir_vectors[DIR_COUNT] = {{0, -1}, {-1, 0}, {0, 1}, {1, 0}};
 global v2i ghost_scatter_targets[GHOST_TYPE_COUNT] = {
     {24, 4}, {3, 5}, {27, 33}, {3, 33}};
-global v2 bonus_pos = {120, 172};
-global v2 ghost_home_positions[GHOST_TYPE_COUNT] = {
-    {120, 148}, {120, 148}, {104, 148}, {136, 148}};
-
-internal f32 fabs(f32 x) { return x < 0 ? x * -1 : x; }
+global v2i bonus_pos = {SUBPX(120), SUBPX(172)};
+global u32 pacman_anim_indexes_in_sprite[PACMAN_ANIM_TYPE_COUNT] = {
+    [PACMAN_IDLING] = 0,     [PACMAN_GOING_LEFT] = 4,
+    [PACMAN_GOING_RIGHT] = 0, [PACMAN_GOING_UP] = 8,
+    [PACMAN_GOING_DOWN] = 12, [PACMAN_DYING] = 16,
+};
+global u32 pacman_anim_frame_counts[PACMAN_ANIM_TYPE_COUNT] = {
+    [PACMAN_IDLING] = PACMAN_IDLE_ANIM_FRAME_COUNT,
+    [PACMAN_GOING_LEFT] = PACMAN_MOVE_ANIM_FRAME_COUNT,
+    [PACMAN_GOING_RIGHT] = PACMAN_MOVE_ANIM_FRAME_COUNT,
+    [PACMAN_GOING_UP] = PACMAN_MOVE_ANIM_FRAME_COUNT,
+    [PACMAN_GOING_DOWN] = PACMAN_MOVE_ANIM_FRAME_COUNT,
+    [PACMAN_DYING] = PACMAN_DIE_ANIM_FRAME_COUNT,
+};
+// Only the moving frames differ per ghost, they are on the ghost's own row.
+#define GHOST_ANIM_INDEXES(row)                                 \
+    {                                                           \
+        [GHOST_GOING_LEFT] = (row) * SPRITE_TILES_X + 2,        \
+        [GHOST_GOING_RIGHT] = (row) * SPRITE_TILES_X + 0,       \
+        [GHOST_GOING_UP] = (row) * SPRITE_TILES_X + 4,          \
+        [GHOST_GOING_DOWN] = (row) * SPRITE_TILES_X + 6,        \
+        [GHOST_PANICKING] = 4 * SPRITE_TILES_X + 8,             \
+        [GHOST_RECOVERING] = 4 * SPRITE_TILES_X + 8,            \
+        [GHOST_EYES_LEFT] = 5 * SPRITE_TILES_X + 9,             \
+        [GHOST_EYES_RIGHT] = 5 * SPRITE_TILES_X + 8,            \
+        [GHOST_EYES_UP] = 5 * SPRITE_TILES_X + 10,              \
+        [GHOST_EYES_DOWN] = 5 * SPRITE_TILES_X + 11,            \
+        [GHOST_EATEN_200] = 8 * SPRITE_TILES_X,                 \
+        [GHOST_EATEN_400] = 8 * SPRITE_TILES_X + 1,             \
+        [GHOST_EATEN_800] = 8 * SPRITE_TILES_X + 2,             \
+        [GHOST_EATEN_1600] = 8 * SPRITE_TILES_X + 3,            \
+    }
+global u32 ghost_anim_indexes_in_sprite[GHOST_TYPE_COUNT]
+                                       [GHOST_ANIM_TYPE_COUNT] = {
+    [GHOST_BLINKY] = GHOST_ANIM_INDEXES(4),
+    [GHOST_PINKY] = GHOST_ANIM_INDEXES(5),
+    [GHOST_INKY] = GHOST_ANIM_INDEXES(6),
+    [GHOST_CLYDE] = GHOST_ANIM_INDEXES(7),
+};
+global u32 ghost_anim_frame_counts[GHOST_ANIM_TYPE_COUNT] = {
+    [GHOST_GOING_LEFT] = GHOST_MOVE_ANIM_FRAME_COUNT,
+    [GHOST_GOING_RIGHT] = GHOST_MOVE_ANIM_FRAME_COUNT,
+    [GHOST_GOING_UP] = GHOST_MOVE_ANIM_FRAME_COUNT,
+    [GHOST_GOING_DOWN] = GHOST_MOVE_ANIM_FRAME_COUNT,
+    [GHOST_PANICKING] = GHOST_PANIC_ANIM_FRAME_COUNT,
+    [GHOST_RECOVERING] = GHOST_RECOVER_ANIM_FRAME_COUNT,
+    [GHOST_EYES_LEFT] = GHOST_EYES_ANIM_FRAME_COUNT,
+    [GHOST_EYES_RIGHT] = GHOST_EYES_ANIM_FRAME_COUNT,
+    [GHOST_EYES_UP] = GHOST_EYES_ANIM_FRAME_COUNT,
+    [GHOST_EYES_DOWN] = GHOST_EYES_ANIM_FRAME_COUNT,
+    [GHOST_EATEN_200] = GHOST_EATEN_ANIM_FRAME_COUNT,
+    [GHOST_EATEN_400] = GHOST_EATEN_ANIM_FRAME_COUNT,
+    [GHOST_EATEN_800] = GHOST_EATEN_ANIM_FRAME_COUNT,
+    [GHOST_EATEN_1600] = GHOST_EATEN_ANIM_FRAME_COUNT,
+};
+global v2i ghost_home_positions[GHOST_TYPE_COUNT] = {
+    {SUBPX(120), SUBPX(148)},
+    {SUBPX(120), SUBPX(148)},
+    {SUBPX(104), SUBPX(148)},
+    {SUBPX(136), SUBPX(148)}};
+
+internal i32 iabs(i32 x) { return x < 0 ? -x : x; }
 
 internal u32 xorshift32() {
     u32 x = game.xorshift;
@@ -273,13 +620,10 @@ internal i32 dist_sq(v2i p1, v2i p2) {
     return ((x_diff * x_diff) + (y_diff * y_diff));
 }
 
-internal b32 in_range(v2 dist, f32 range) {
-    return fabs(dist.x) < range && fabs(dist.y) < range ? 1 : 0;
+internal b32 in_range(v2i dist, i32 range) {
+    return iabs(dist.x) < range && iabs(dist.y) < range ? 1 : 0;
 }
 
-internal v2 v2_add(v2 vec1, v2 vec2) {
-    return (v2){vec1.x + vec2.x, vec1.y + vec2.y};
-}
 internal v2u v2u_add(v2u vec1, v2u vec2) {
     return (v2u){vec1.x + vec2.x, vec1.y + vec2.y};
 }
@@ -287,9 +631,6 @@ internal v2i v2i_add(v2i vec1, v2i vec2) {
     return (v2i){vec1.x + vec2.x, vec1.y + vec2.y};
 }
 
-internal v2 v2_sub(v2 vec1, v2 vec2) {
-    return (v2){vec1.x - vec2.x, vec1.y - vec2.y};
-}
 internal v2u v2u_sub(v2u vec1, v2u vec2) {
     return (v2u){vec1.x - vec2.x, vec1.y - vec2.y};
 }
@@ -305,37 +646,6 @@ internal b32 v2i_is_equal(v2i vec1, v2i vec2) {
     return vec1.x == vec2.x && vec1.y == vec2.y ? 1 : 0;
 }
 
-#define ANSI_RED "\x1b[31m"
-#define ANSI_GREEN "\x1b[32m"
-#define ANSI_YELLOW "\x1b[33m"
-#define ANSI_BLUE "\x1b[34m"
-#define ANSI_MAGENTA "\x1b[35m"
-#define ANSI_CYAN "\x1b[36m"
-#define ANSI_RESET "\x1b[0m"
-
-void trace_log_callback(int log_type, const char *text, va_list args) {
-    char message[256];
-    vsprintf_s(message, sizeof(message), text, args);
-
-    switch (log_type) {
-        case LOG_INFO:
-            printf(ANSI_CYAN "[INFO]" ANSI_RESET " %s\n", message);
-            break;
-        case LOG_WARNING:
-            printf(ANSI_YELLOW "[WARNING]" ANSI_RESET " %s\n", message);
-            break;
-        case LOG_ERROR:
-            printf(ANSI_RED "[ERROR]" ANSI_RESET " %s\n", message);
-            break;
-        case LOG_DEBUG:
-            printf(ANSI_GREEN "[DEBUG]" ANSI_RESET " %s\n", message);
-            break;
-        default:
-            printf("%s\n", message);
-            break;
-    }
-}
-
 internal void init_tile_map(u32 *tile_map) {
     u32 tile_map_master[SCREEN_TILES_Y][SCREEN_TILES_X] = {
         {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -459,53 +769,32 @@ internal void init_tile_map(u32 *tile_map) {
     }
 }
 
-internal u32 *get_tile_map() {
-    u32 tile_count = SCREEN_TILES_X * SCREEN_TILES_Y;
-    u32 *result = (u32 *)MemAlloc(tile_count * sizeof(u32));
-    return result;
+internal b32 init_memory() {
+    return init_arena(&permanent_arena, "permanent", PERMANENT_ARENA_SIZE);
 }
 
-internal Rectangle *get_sprite_tiles() {
-    u32 tile_count = SPRITE_TILES_X * SPRITE_TILES_Y;
-    Rectangle *result = (Rectangle *)MemAlloc(tile_count * sizeof(Rectangle));
-
-    for (i32 y = 0; y < SPRITE_TILES_Y; y++) {
-        for (i32 x = 0; x < SPRITE_TILES_X; x++) {
-            result[(y * SPRITE_TILES_X) + x] = (Rectangle){
-                (f32)SPRITE_TILE_WIDTH * x, (f32)SPRITE_TILE_HEIGHT * y,
-                SPRITE_TILE_WIDTH, SPRITE_TILE_HEIGHT};
-        }
-    }
-
-    return result;
+internal void log_memory_usage() {
+    TraceLog(LOG_INFO, "MEMORY: [%s] %llu KB peak, %llu KB committed",
+             permanent_arena.name, permanent_arena.peak / 1024,
+             permanent_arena.committed / 1024);
 }
 
-internal Rectangle *get_maze_tiles() {
-    u32 tile_count = 2;
-    Rectangle *result = (Rectangle *)MemAlloc(tile_count * sizeof(Rectangle));
-
-    Rectangle blue_maze = (Rectangle){0, 0, 28 * TILE_WIDTH, 31 * TILE_HEIGHT};
-    Rectangle white_maze =
-        (Rectangle){28 * TILE_WIDTH, 0, 28 * TILE_WIDTH, 31 * TILE_HEIGHT};
-
-    result[0] = blue_maze;
-    result[1] = white_maze;
-
-    return result;
+internal u32 *get_tile_map() {
+    return push_array(&permanent_arena, u32, SCREEN_TILES_X * SCREEN_TILES_Y);
 }
 
 internal void init_pacman(Rectangle *sprite_tiles) {
     PacMan *pacman = &game.pacman;
     pacman->actor.can_turn = 1;
-    pacman->actor.pos = (v2){120, 220};
-    pacman->actor.vel = (v2){game.level.pacman_speed, game.level.pacman_speed};
+    pacman->actor.pos = (v2i){SUBPX(120), SUBPX(220)};
+    pacman->actor.speed = &game.level->pacman_speed;
     pacman->actor.dir = DIR_LEFT;
     pacman->state = PACMAN_MOVING;
 
     pacman->anim_type = PACMAN_GOING_LEFT;
     pacman->anim.frames =
-        sprite_tiles + pacman->anim_indexes_in_sprite[pacman->anim_type];
-    pacman->anim.frame_count = pacman->anim_frame_counts[pacman->anim_type];
+        sprite_tiles + pacman_anim_indexes_in_sprite[pacman->anim_type];
+    pacman->anim.frame_count = pacman_anim_frame_counts[pacman->anim_type];
     pacman->anim.frame_counter = 0;
     pacman->anim.ticks_per_anim_frame = PACMAN_TICKS_PER_ANIM_FRAME;
     pacman->anim.frame_index = 0;
@@ -519,70 +808,85 @@ internal void init_ghosts(Rectangle *sprite_tiles) {
         switch (ghost->type) {
             case GHOST_BLINKY:
                 ghost->state = GHOST_SCATTER;
-                ghost->actor.pos = (v2){DOOR_ENTRY_X, DOOR_ENTRY_Y};
-                ghost->actor.vel =
-                    (v2){game.level.ghost_speed, game.level.ghost_speed};
+                ghost->actor.pos = (v2i){DOOR_ENTRY_X, DOOR_ENTRY_Y};
+                ghost->actor.speed = &game.level->ghost_speed;
                 ghost->actor.dir = DIR_LEFT;
                 ghost->anim_type = GHOST_GOING_LEFT;
                 break;
             case GHOST_PINKY:
                 ghost->state = GHOST_LEAVE_HOME;
                 ghost->actor.pos =
-                    (v2){GHOST_HOME_CENTER_X, GHOST_HOME_CENTER_Y};
-                ghost->actor.vel = (v2){game.level.ghost_home_speed,
-                                        game.level.ghost_home_speed};
+                    (v2i){GHOST_HOME_CENTER_X, GHOST_HOME_CENTER_Y};
+                ghost->actor.speed = &game.level->ghost_home_speed;
                 ghost->actor.dir = DIR_DOWN;
                 ghost->anim_type = GHOST_GOING_DOWN;
                 break;
             case GHOST_INKY:
                 ghost->state = GHOST_HOME;
-                ghost->actor.pos = (v2){GHOST_HOME_CENTER_X - (2 * TILE_WIDTH),
-                                        GHOST_HOME_CENTER_Y};
-                ghost->actor.vel = (v2){game.level.ghost_home_speed,
-                                        game.level.ghost_home_speed};
+                ghost->actor.pos =
+                    (v2i){GHOST_HOME_CENTER_X - SUBPX(2 * TILE_WIDTH),
+                          GHOST_HOME_CENTER_Y};
+                ghost->actor.speed = &game.level->ghost_home_speed;
                 ghost->actor.dir = DIR_UP;
                 ghost->anim_type = GHOST_GOING_UP;
                 break;
             case GHOST_CLYDE:
                 ghost->state = GHOST_HOME;
-                ghost->actor.pos = (v2){GHOST_HOME_CENTER_X + (2 * TILE_WIDTH),
-                                        GHOST_HOME_CENTER_Y};
-                ghost->actor.vel = (v2){game.level.ghost_home_speed,
-                                        game.level.ghost_home_speed};
+                ghost->actor.pos =
+                    (v2i){GHOST_HOME_CENTER_X + SUBPX(2 * TILE_WIDTH),
+                          GHOST_HOME_CENTER_Y};
+                ghost->actor.speed = &game.level->ghost_home_speed;
                 ghost->actor.dir = DIR_UP;
                 ghost->anim_type = GHOST_GOING_UP;
                 break;
         }
 
         ghost->anim.frames =
-            sprite_tiles + ghost->anim_indexes_in_sprite[ghost->anim_type];
-        ghost->anim.frame_count = ghost->anim_frame_counts[ghost->anim_type];
+            sprite_tiles +
+            ghost_anim_indexes_in_sprite[ghost->type][ghost->anim_type];
+        ghost->anim.frame_count = ghost_anim_frame_counts[ghost->anim_type];
         ghost->anim.frame_counter = 0;
         ghost->anim.ticks_per_anim_frame = GHOST_TICKS_PER_ANIM_FRAME;
         ghost->anim.frame_index = 0;
     }
 }
 
-internal void init_round(Rectangle *sprite_tiles) {
-    init_pacman(sprite_tiles);
-    init_ghosts(sprite_tiles);
+// Spreads `permille` of MAX_SPEED over SPEED_PATTERN_TICKS ticks so that the
+// sub-pixel steps of any two consecutive ticks differ by at most one.
+internal SpeedPattern get_speed_pattern(u32 permille) {
+    SpeedPattern result = {0};
+    u32 total = (MAX_SPEED * SUBPIXELS * SPEED_PATTERN_TICKS * permille +
+                 (FPS * 1000) / 2) /
+                (FPS * 1000);
+
+    for (u32 i = 0; i < SPEED_PATTERN_TICKS; i++) {
+        result.steps[i] = (u8)(((i + 1) * total) / SPEED_PATTERN_TICKS -
+                               (i * total) / SPEED_PATTERN_TICKS);
+    }
+
+    return result;
+}
+
+internal i32 get_step(SpeedPattern *speed) {
+    return speed->steps[game.tick % SPEED_PATTERN_TICKS];
 }
 
-internal v2 get_next_pos(v2 *curr_pos, v2 *vel, v2i *dir_vec, f32 dt) {
-    v2 pos_change = (v2){vel->x * dir_vec->x * dt, vel->y * dir_vec->y * dt};
-    v2 next_pos = v2_add(*curr_pos, pos_change);
+internal v2i get_next_pos(v2i *curr_pos, SpeedPattern *speed, v2i *dir_vec) {
+    i32 step = get_step(speed);
+    v2i pos_change = (v2i){step * dir_vec->x, step * dir_vec->y};
+    v2i next_pos = v2i_add(*curr_pos, pos_change);
     return next_pos;
 }
 
-internal b32 can_move(u32 *tile_map, v2 *next_pos, v2i *curr_tile,
-                      v2 *curr_tile_pos, v2i *dir_vec, b32 is_dir_same) {
+internal b32 can_move(u32 *tile_map, v2i *next_pos, v2i *curr_tile,
+                      v2i *curr_tile_pos, v2i *dir_vec, b32 is_dir_same) {
     v2i next_tile = v2i_add(*curr_tile, *dir_vec);
 
     if (next_tile.x < 0 || next_tile.x >= SCREEN_TILES_X) {
         return 1;
     }
 
-    v2 dist_to_tile_mid = v2_sub(*next_pos, *curr_tile_pos);
+    v2i dist_to_tile_mid = v2i_sub(*next_pos, *curr_tile_pos);
     b32 result = 0;
     i32 tile_type = tile_map[(next_tile.y * SCREEN_TILES_X) + next_tile.x];
     b32 is_tile_occupied =
@@ -590,7 +894,7 @@ internal b32 can_move(u32 *tile_map, v2 *next_pos, v2i *curr_tile,
     b32 can_corner = 0;
 
     if (dir_vec->x != 0) {
-        can_corner = fabs(dist_to_tile_mid.y) <= PACMAN_CORNERING_RANGE;
+        can_corner = iabs(dist_to_tile_mid.y) <= PACMAN_CORNERING_RANGE;
         result = (is_dir_same && ((dist_to_tile_mid.x * dir_vec->x) <= 0 ||
                                   !is_tile_occupied)) ||
                          (!is_dir_same && !is_tile_occupied && can_corner)
@@ -599,7 +903,7 @@ internal b32 can_move(u32 *tile_map, v2 *next_pos, v2i *curr_tile,
     }
 
     if (dir_vec->y != 0) {
-        can_corner = fabs(dist_to_tile_mid.x) <= PACMAN_CORNERING_RANGE;
+        can_corner = iabs(dist_to_tile_mid.x) <= PACMAN_CORNERING_RANGE;
         result = (is_dir_same && ((dist_to_tile_mid.y * dir_vec->y) <= 0 ||
                                   !is_tile_occupied)) ||
                          (!is_dir_same && !is_tile_occupied && can_corner)
@@ -610,10 +914,10 @@ internal b32 can_move(u32 *tile_map, v2 *next_pos, v2i *curr_tile,
     return result;
 }
 
-internal void move(v2 *curr_pos, v2 *curr_tile_pos, v2 *next_pos, v2i *dir_vec,
-                   b32 is_dir_same) {
+internal void move(v2i *curr_pos, v2i *curr_tile_pos, v2i *next_pos,
+                   v2i *dir_vec, b32 is_dir_same) {
     if (!is_dir_same) {
-        v2 dist_to_tile_mid = v2_sub(*next_pos, *curr_tile_pos);
+        v2i dist_to_tile_mid = v2i_sub(*next_pos, *curr_tile_pos);
 
         if (dir_vec->x != 0) {
             next_pos->y -= dist_to_tile_mid.y;
@@ -626,10 +930,10 @@ internal void move(v2 *curr_pos, v2 *curr_tile_pos, v2 *next_pos, v2i *dir_vec,
     curr_pos->y = next_pos->y;
 }
 
-internal void resolve_wall_collision(v2 *next_pos, v2 *curr_tile_pos,
+internal void resolve_wall_collision(v2i *next_pos, v2i *curr_tile_pos,
                                      v2i *dir_vec) {
     // TraceLog(LOG_DEBUG, "========== COLLISION RESOLUTION ==========\n");
-    v2 dist_to_tile_mid = v2_sub(*next_pos, *curr_tile_pos);
+    v2i dist_to_tile_mid = v2i_sub(*next_pos, *curr_tile_pos);
 
     if (dir_vec->x != 0) {
         next_pos->x -= dist_to_tile_mid.x;
@@ -639,13 +943,17 @@ internal void resolve_wall_collision(v2 *next_pos, v2 *curr_tile_pos,
     }
 }
 
-internal v2i get_tile(v2 pos) {
-    return (v2i){(i32)(pos.x * TILE_WIDTH_INV), (i32)(pos.y * TILE_HEIGHT_INV)};
+internal v2i get_tile(v2i pos) {
+    return (v2i){pos.x / SUBPX(TILE_WIDTH), pos.y / SUBPX(TILE_HEIGHT)};
+}
+
+internal v2i get_tile_pos(v2i tile) {
+    return (v2i){SUBPX(tile.x * TILE_WIDTH) + SUBPX(TILE_WIDTH) / 2,
+                 SUBPX(tile.y * TILE_HEIGHT) + SUBPX(TILE_HEIGHT) / 2};
 }
 
-internal v2 get_tile_pos(v2i tile) {
-    return (v2){(f32)((tile.x + 0.5f) * TILE_WIDTH),
-                (f32)((tile.y + 0.5f) * TILE_HEIGHT)};
+internal v2 get_screen_pos(v2i pos) {
+    return (v2){(f32)pos.x / SUBPIXELS, (f32)pos.y / SUBPIXELS};
 }
 
 internal Direction get_opposite_dir(Direction dir) {
@@ -674,11 +982,36 @@ internal void update_animation_frame(Animation *anim) {
     }
 }
 
-internal b32 is_now(u32 tick) { return tick == game.tick; }
+internal void mark_dot_eaten(v2i tile) {
+    DotChanges *changes = &game.dot_changes;
+    if (changes->count < DOT_CHANGE_CAPACITY) {
+        changes->tiles[changes->count++] = tile;
+    } else {
+        changes->refilled = 1;
+    }
+}
+
+// Ticks from the event to now, negative while it is still ahead. Only means
+// something for a scheduled event.
+internal i64 since(Event *ev) { return (i64)(game.tick - ev->tick); }
+
+internal b32 is_ticks_after(Event *ev, i64 ticks) {
+    return ev->scheduled && since(ev) == ticks;
+}
+
+internal b32 is_now(Event *ev) { return is_ticks_after(ev, 0); }
+
+// Now or earlier.
+internal b32 has_reached(Event *ev) { return ev->scheduled && since(ev) >= 0; }
+
+internal b32 has_passed(Event *ev) { return ev->scheduled && since(ev) > 0; }
 
-internal u32 since(u32 tick) { return game.tick - tick; }
+internal void after(Event *ev, u64 ticks) {
+    ev->tick = game.tick + ticks;
+    ev->scheduled = 1;
+}
 
-internal void after(Event *ev, u32 tick) { ev->tick = game.tick + tick; }
+internal void cancel(Event *ev) { ev->scheduled = 0; }
 
 internal b32 in_red_zone(v2i tile) {
     return tile.x > 11 && tile.x < 18 && (tile.y == 15 || tile.y == 27) ? 1 : 0;
@@ -691,36 +1024,81 @@ internal b32 in_tunnel(v2i tile) {
                : 0;
 }
 
-internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
-                           u32 *tile_map, f32 dt) {
+internal TickContext prepare_tick() {
+    TickContext context = {0};
+    context.level = game.level;
+    context.pacman_pos = game.pacman.actor.pos;
+    context.pacman_tile = get_tile(game.pacman.actor.pos);
+    context.pacman_dir = game.pacman.actor.dir;
+    context.blinky_tile = get_tile(game.ghosts[GHOST_BLINKY].actor.pos);
+    context.dots_eaten =
+        (DOT_COUNT + PILL_COUNT) - (game.dots_left + game.pills_left);
+
+    i64 ticks_since_play = since(&game.play);
+    if ((ticks_since_play >= 7 * FPS && ticks_since_play < 27 * FPS) ||
+        (ticks_since_play >= 34 * FPS && ticks_since_play < 54 * FPS) ||
+        ticks_since_play >= 61 * FPS) {
+        context.schedule_state = GHOST_CHASE;
+    } else {
+        context.schedule_state = GHOST_SCATTER;
+    }
+
+    u32 dots_left = game.dots_left + game.pills_left;
+    if (dots_left <= game.level->elroy2_dots_left) {
+        context.elroy = ELROY_2;
+    } else if (dots_left <= game.level->elroy1_dots_left) {
+        context.elroy = ELROY_1;
+    }
+
+    // The recovery ticks only move when a ghost outside the house panics,
+    // which update_ghost() decides; this is what they will be if one does.
+    context.pill_chomped = is_now(&game.pill_chomp);
+    context.start_recovery = game.ghost_start_recovery;
+    context.recover = game.ghost_recover;
+    if (context.pill_chomped) {
+        after(&context.recover, game.level->ghost_panic_ticks);
+        // Flashing can take longer than the whole panic, then the ghosts
+        // flash from the start.
+        context.start_recovery = context.recover;
+        context.start_recovery.tick -= game.level->ghost_flash_count *
+                                       GHOST_RECOVER_ANIM_FRAME_COUNT *
+                                       GHOST_TICKS_PER_ANIM_FRAME;
+    }
+    context.recovery_started = has_reached(&context.start_recovery);
+    context.panic_over = has_reached(&context.recover);
+    context.panicking =
+        has_reached(&game.pill_chomp) && !has_reached(&context.recover);
+    return context;
+}
+
+internal void update_ghost(GhostType ghost_type, TickContext *context,
+                           Rectangle *sprite_tiles, u32 *tile_map) {
     Ghost *ghost = &game.ghosts[ghost_type];
     GhostState old_state = ghost->state;
     Direction old_dir = ghost->actor.dir;
     v2i curr_tile = get_tile(ghost->actor.pos);
-    v2 curr_tile_pos = get_tile_pos(curr_tile);
-    v2 dist_to_tile_mid = v2_sub(curr_tile_pos, ghost->actor.pos);
-    v2 ghost_home_pos = ghost_home_positions[ghost_type];
+    v2i curr_tile_pos = get_tile_pos(curr_tile);
+    v2i dist_to_tile_mid = v2i_sub(curr_tile_pos, ghost->actor.pos);
+    v2i ghost_home_pos = ghost_home_positions[ghost_type];
 
     // ==================== GHOST STATE UPDATE ==================== //
 
     if (old_state == GHOST_HOME) {
-        u32 total_dots_eatens =
-            (DOT_COUNT + PILL_COUNT) - (game.dots_left + game.pills_left);
-        if (total_dots_eatens >= game.level.inky_dot_limit &&
+        if (context->dots_eaten >= context->level->inky_dot_limit &&
             ghost->type == GHOST_INKY) {
             ghost->state = GHOST_LEAVE_HOME;
         }
-        if (total_dots_eatens >= game.level.clyde_dot_limit &&
+        if (context->dots_eaten >= context->level->clyde_dot_limit &&
             ghost->type == GHOST_CLYDE) {
             ghost->state = GHOST_LEAVE_HOME;
         }
     } else if (old_state == GHOST_PANIC || old_state == GHOST_RECOVER) {
-        v2 dist_to_pacman = v2_sub(game.pacman.actor.pos, ghost->actor.pos);
+        v2i dist_to_pacman = v2i_sub(context->pacman_pos, ghost->actor.pos);
         if (in_range(dist_to_pacman, COLLISION_RANGE)) {
-            ghost->eaten.tick = game.tick;
-            game.freeze.tick = game.tick + 1;
+            after(&ghost->eaten, 0);
+            after(&game.freeze, 1);
             game.ghost_eaten_count += 1;
-            PlaySound(game.ghost_eat_sfx);
+            PlaySound(audio.ghost_eat_sfx);
             if (game.ghost_eaten_count == 1) {
                 game.score += 200;
             } else if (game.ghost_eaten_count == 2) {
@@ -731,77 +1109,61 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
                 game.score += 1600;
             }
             after(&ghost->turned_to_eyes, (1 * FPS));
-            TraceLog(LOG_DEBUG, "GHOST EATEN!!");
+            DEBUG_LOG("GHOST EATEN!!");
             after(&game.resume, 1 * FPS);
             after(&ghost->turned_to_eyes, (1 * FPS));
         }
     } else if (old_state == GHOST_EYES) {
-        v2 dist_to_door =
-            v2_sub(((v2){DOOR_ENTRY_X, DOOR_ENTRY_Y}), ghost->actor.pos);
+        v2i dist_to_door =
+            v2i_sub(((v2i){DOOR_ENTRY_X, DOOR_ENTRY_Y}), ghost->actor.pos);
         if (in_range(dist_to_door, GHOST_CORNERING_RANGE)) {
-            TraceLog(LOG_DEBUG, "GHOST AT DOOR!! \n");
+            DEBUG_LOG("GHOST AT DOOR!! \n");
             ghost->state = GHOST_ENTER_HOME;
         }
     } else if (old_state == GHOST_ENTER_HOME) {
-        v2 dist_to_home = v2_sub(ghost_home_pos, ghost->actor.pos);
+        v2i dist_to_home = v2i_sub(ghost_home_pos, ghost->actor.pos);
         if (in_range(dist_to_home, GHOST_CORNERING_RANGE)) {
             ghost->state = GHOST_LEAVE_HOME;
         }
     } else if (old_state == GHOST_LEAVE_HOME) {
-        v2 dist_to_door =
-            v2_sub(((v2){DOOR_ENTRY_X, DOOR_ENTRY_Y}), ghost->actor.pos);
+        v2i dist_to_door =
+            v2i_sub(((v2i){DOOR_ENTRY_X, DOOR_ENTRY_Y}), ghost->actor.pos);
         if (in_range(dist_to_door, GHOST_CORNERING_RANGE)) {
             ghost->state = GHOST_SCATTER;
         }
     }
 
-    if (game.tick == game.pill_chomp.tick &&
+    if (context->pill_chomped &&
         (ghost->state != GHOST_HOME && ghost->state != GHOST_ENTER_HOME &&
          ghost->state != GHOST_LEAVE_HOME)) {
-        game.ghost_recover.tick = game.tick + game.level.ghost_panic_ticks;
-        game.ghost_start_recovery.tick =
-            game.ghost_recover.tick -
-            (game.level.ghost_flash_count * GHOST_RECOVER_ANIM_FRAME_COUNT *
-             GHOST_TICKS_PER_ANIM_FRAME);
+        game.ghost_recover = context->recover;
+        game.ghost_start_recovery = context->start_recovery;
         ghost->state = GHOST_PANIC;
-    } else if (game.tick >= game.ghost_start_recovery.tick && ghost->state == GHOST_PANIC) {
+    } else if (context->recovery_started && ghost->state == GHOST_PANIC) {
         ghost->state = GHOST_RECOVER;
-    } else if (game.tick == ghost->eaten.tick) {
+    } else if (is_now(&ghost->eaten)) {
         ghost->state = GHOST_EATEN;
-    } else if (game.tick == ghost->turned_to_eyes.tick) {
+    } else if (is_now(&ghost->turned_to_eyes)) {
         ghost->state = GHOST_EYES;
-    } else if ((game.tick >= game.ghost_recover.tick && old_state == GHOST_RECOVER) || old_state == GHOST_CHASE ||
-               old_state == GHOST_SCATTER) {
-        u32 ticks_since_play = since(game.play.tick);
-        if (ticks_since_play < 7 * FPS) {
-            ghost->state = GHOST_SCATTER;
-        } else if (ticks_since_play < 27 * FPS) {
-            ghost->state = GHOST_CHASE;
-        } else if (ticks_since_play < 34 * FPS) {
-            ghost->state = GHOST_SCATTER;
-        } else if (ticks_since_play < 54 * FPS) {
-            ghost->state = GHOST_CHASE;
-        } else if (ticks_since_play < 61 * FPS) {
-            ghost->state = GHOST_SCATTER;
-        } else {
-            ghost->state = GHOST_CHASE;
-        }
+    } else if ((context->panic_over && old_state == GHOST_RECOVER) ||
+               old_state == GHOST_CHASE || old_state == GHOST_SCATTER) {
+        ghost->state = context->schedule_state;
     }
     
-    TraceLog(LOG_DEBUG, "GHOST STATE: %d\n", ghost->state);
+    DEBUG_LOG("GHOST STATE: %d\n", ghost->state);
 
     // ==================== GHOST DIRECTION UPDATE ==================== //
 
     b32 can_corner = 0;
-    v2 dist_to_ghost_home_center = {0};
+    v2i dist_to_ghost_home_center = {0};
     if (ghost->state == GHOST_HOME) {
-        if (ghost->actor.pos.y >= 19 * TILE_HEIGHT) {
+        if (ghost->actor.pos.y >= SUBPX(19 * TILE_HEIGHT)) {
             ghost->actor.dir = DIR_UP;
-        } else if (ghost->actor.pos.y <= 18 * TILE_HEIGHT) {
+        } else if (ghost->actor.pos.y <= SUBPX(18 * TILE_HEIGHT)) {
             ghost->actor.dir = DIR_DOWN;
         }
     } else if (ghost->state == GHOST_ENTER_HOME) {
-        can_corner = fabs((f32)GHOST_HOME_CENTER_Y - ghost->actor.pos.y) <
+        can_corner = iabs(GHOST_HOME_CENTER_Y - ghost->actor.pos.y) <
                              GHOST_CORNERING_RANGE
                          ? 1
                          : 0;
@@ -815,11 +1177,11 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
             ghost->actor.dir = DIR_DOWN;
         }
     } else if (ghost->state == GHOST_LEAVE_HOME) {
-        dist_to_ghost_home_center = v2_sub(
-            (v2){GHOST_HOME_CENTER_X, GHOST_HOME_CENTER_Y}, ghost->actor.pos);
-        if (fabs(dist_to_ghost_home_center.x) < GHOST_CORNERING_RANGE) {
+        dist_to_ghost_home_center = v2i_sub(
+            (v2i){GHOST_HOME_CENTER_X, GHOST_HOME_CENTER_Y}, ghost->actor.pos);
+        if (iabs(dist_to_ghost_home_center.x) < GHOST_CORNERING_RANGE) {
              ghost->actor.dir = DIR_UP;
-        } else if (fabs(dist_to_ghost_home_center.y) < GHOST_CORNERING_RANGE) {
+        } else if (iabs(dist_to_ghost_home_center.y) < GHOST_CORNERING_RANGE) {
             if (ghost->actor.pos.x > GHOST_HOME_CENTER_X) {
                 ghost->actor.dir = DIR_LEFT;
             } else {
@@ -838,10 +1200,10 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
         v2i dir_vec = dir_vectors[ghost->actor.dir];
         if (dir_vec.x != 0) {
             can_corner =
-                fabs(dist_to_tile_mid.x) < ghost->actor.cornering_range;
+                iabs(dist_to_tile_mid.x) < ghost->actor.cornering_range;
         } else {
             can_corner =
-                fabs(dist_to_tile_mid.y) < ghost->actor.cornering_range;
+                iabs(dist_to_tile_mid.y) < ghost->actor.cornering_range;
         }
 
         // Ensure that the ghost has moved out of the cornering region after a
@@ -860,7 +1222,8 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
         if (can_corner && ghost->actor.can_turn) {
             Direction reverse_dir = get_opposite_dir(ghost->actor.dir);
             v2i target_tile = (v2i){0, 0};
-            v2i pacman_tile = get_tile(game.pacman.actor.pos);
+            v2i pacman_tile = context->pacman_tile;
+            v2i pacman_dir_vec = dir_vectors[context->pacman_dir];
 
             switch (ghost->state) {
                 case GHOST_SCATTER:
@@ -877,19 +1240,16 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
                 default:
                     switch (ghost->type) {
                         case GHOST_BLINKY:
-                            target_tile = get_tile(game.pacman.actor.pos);
+                            target_tile = pacman_tile;
                             break;
                         case GHOST_PINKY:
                             target_tile = v2i_add(
-                                pacman_tile,
-                                v2i_mul(dir_vectors[game.pacman.actor.dir], 4));
+                                pacman_tile, v2i_mul(pacman_dir_vec, 4));
                             break;
                         case GHOST_INKY:
-                            v2i blinky_tile =
-                                get_tile(game.ghosts[GHOST_BLINKY].actor.pos);
+                            v2i blinky_tile = context->blinky_tile;
                             v2i two_ahead_pacman = v2i_add(
-                                pacman_tile,
-                                v2i_mul(dir_vectors[game.pacman.actor.dir], 2));
+                                pacman_tile, v2i_mul(pacman_dir_vec, 2));
                             v2i dist = v2i_sub(two_ahead_pacman, blinky_tile);
                             target_tile =
                                 v2i_add(blinky_tile, v2i_mul(dist, 2));
@@ -949,43 +1309,14 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
 
     // ==================== GHOST VELOCITY UPDATE ==================== //
 
-    switch (ghost->state) {
-        case GHOST_CHASE:
-        case GHOST_SCATTER:
-            TraceLog(LOG_DEBUG, "CURR GHOST TILE: [%d][%d]\n", curr_tile.x,
-                     curr_tile.y);
-            if (in_tunnel(curr_tile)) {
-                ghost->actor.vel = (v2){game.level.ghost_tunnel_speed,
-                                        game.level.ghost_tunnel_speed};
-            } else {
-                ghost->actor.vel =
-                    (v2){game.level.ghost_speed, game.level.ghost_speed};
-            }
-
-            if (ghost->type == GHOST_BLINKY) {
-                u32 total_dot_left = game.dots_left + game.pills_left;
-                if (total_dot_left <= game.level.elroy2_dots_left) {
-                    ghost->actor.vel =
-                        (v2){game.level.elroy2_speed, game.level.elroy2_speed};
-                } else if (total_dot_left <= game.level.elroy1_dots_left) {
-                    ghost->actor.vel =
-                        (v2){game.level.elroy1_speed, game.level.elroy1_speed};
-                }
-            }
-            break;
-        case GHOST_PANIC:
-            ghost->actor.vel = (v2){game.level.ghost_panic_speed,
-                                    game.level.ghost_panic_speed};
-            break;
-        case GHOST_EYES:
-        case GHOST_ENTER_HOME:
-            ghost->actor.vel =
-                (v2){game.level.ghost_eyes_speed, game.level.ghost_eyes_speed};
-            break;
-        case GHOST_LEAVE_HOME:
-            ghost->actor.vel =
-                (v2){game.level.ghost_home_speed, game.level.ghost_home_speed};
-            break;
+    DEBUG_LOG("CURR GHOST TILE: [%d][%d]\n", curr_tile.x, curr_tile.y);
+    ElroyLevel elroy =
+        ghost->type == GHOST_BLINKY ? context->elroy : ELROY_NONE;
+    SpeedPattern *speed = context->level->ghost_speeds[ghost->state]
+                                                     [in_tunnel(curr_tile)]
+                                                     [elroy];
+    if (speed) {
+        ghost->actor.speed = speed;
     }
 
     // ==================== GHOST POSITION UPDATE ==================== //
@@ -1004,21 +1335,21 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
         }
     }
     v2i dir_vec = dir_vectors[ghost->actor.dir];
-    TraceLog(LOG_DEBUG, "Direction AFTER update: [%d]\n", ghost->actor.dir);
+    DEBUG_LOG("Direction AFTER update: [%d]\n", ghost->actor.dir);
 
     ghost->actor.pos =
-        get_next_pos(&ghost->actor.pos, &ghost->actor.vel, &dir_vec, dt);
-    if (ghost->actor.pos.x < TILE_WIDTH) {
-        ghost->actor.pos.x = (f32)(BACK_BUFFER_WIDTH - TILE_WIDTH - 1);
-    } else if (ghost->actor.pos.x >= (BACK_BUFFER_WIDTH - TILE_WIDTH)) {
-        ghost->actor.pos.x = TILE_WIDTH;
+        get_next_pos(&ghost->actor.pos, ghost->actor.speed, &dir_vec);
+    if (ghost->actor.pos.x < SUBPX(TILE_WIDTH)) {
+        ghost->actor.pos.x = SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH - 1);
+    } else if (ghost->actor.pos.x >= SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH)) {
+        ghost->actor.pos.x = SUBPX(TILE_WIDTH);
     }
 
     // ==================== GHOST ANIMATION UPDATE ==================== //
 
-    TraceLog(LOG_DEBUG, "Ghost eaten count: [%d]\n", game.ghost_eaten_count);
+    DEBUG_LOG("Ghost eaten count: [%d]\n", game.ghost_eaten_count);
     if (ghost->state != old_state) {
-        TraceLog(LOG_DEBUG, "Ghost animation change as state changed.\n");
+        DEBUG_LOG("Ghost animation change as state changed.\n");
         switch (ghost->state) {
             case GHOST_PANIC:
                 ghost->anim_type = GHOST_PANICKING;
@@ -1043,7 +1374,7 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
                 }
                 break;
             case GHOST_EATEN:
-                TraceLog(LOG_DEBUG, "Ghost eaten animation.\n");
+                DEBUG_LOG("Ghost eaten animation.\n");
                 if (game.ghost_eaten_count == 1) {
                     ghost->anim_type = GHOST_EATEN_200;
                 } else if (game.ghost_eaten_count == 2) {
@@ -1073,8 +1404,9 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
                 break;
         }
         ghost->anim.frames =
-            sprite_tiles + ghost->anim_indexes_in_sprite[ghost->anim_type];
-        ghost->anim.frame_count = ghost->anim_frame_counts[ghost->anim_type];
+            sprite_tiles +
+            ghost_anim_indexes_in_sprite[ghost->type][ghost->anim_type];
+        ghost->anim.frame_count = ghost_anim_frame_counts[ghost->anim_type];
     }
 
     if (ghost->actor.dir != old_dir) {
@@ -1113,13 +1445,14 @@ internal void update_ghost(GhostType ghost_type, Rectangle *sprite_tiles,
             }
         }
         ghost->anim.frames =
-            sprite_tiles + ghost->anim_indexes_in_sprite[ghost->anim_type];
-        ghost->anim.frame_count = ghost->anim_frame_counts[ghost->anim_type];
+            sprite_tiles +
+            ghost_anim_indexes_in_sprite[ghost->type][ghost->anim_type];
+        ghost->anim.frame_count = ghost_anim_frame_counts[ghost->anim_type];
     }
     update_animation_frame(&ghost->anim);
 }
 
-internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
+internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map) {
     PacMan *pacman = &game.pacman;
     PacManState old_state = pacman->state;
     Direction old_dir = pacman->actor.dir;
@@ -1127,69 +1460,53 @@ internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
     if (pacman->state != PACMAN_CAUGHT && pacman->state != PACMAN_DEAD) {
         pacman->state = PACMAN_MOVING;
         v2i curr_tile = get_tile(pacman->actor.pos);
-        v2 curr_tile_pos = {(curr_tile.x + 0.5f) * (f32)TILE_WIDTH,
-                            (curr_tile.y + 0.5f) * (f32)TILE_HEIGHT};
+        v2i curr_tile_pos = get_tile_pos(curr_tile);
         u32 curr_tile_type =
             tile_map[curr_tile.y * SCREEN_TILES_X + curr_tile.x];
         b32 has_dot_or_pill =
             curr_tile_type == TILE_DOT || curr_tile_type == TILE_PILL;
 
         Direction next_dir = pacman->actor.dir;
-        if (IsKeyDown(KEY_LEFT)) {
+        if (game.input & INPUT_LEFT) {
             next_dir = DIR_LEFT;
         }
-        if (IsKeyDown(KEY_RIGHT)) {
+        if (game.input & INPUT_RIGHT) {
             next_dir = DIR_RIGHT;
         }
-        if (IsKeyDown(KEY_UP)) {
+        if (game.input & INPUT_UP) {
             next_dir = DIR_UP;
         }
-        if (IsKeyDown(KEY_DOWN)) {
+        if (game.input & INPUT_DOWN) {
             next_dir = DIR_DOWN;
         }
 
-        if (game.tick == game.pill_chomp.tick) {
+        if (is_now(&game.pill_chomp)) {
             pacman->state = PACMAN_SPEEDING;
             // Set pacman speed to normal when the ghosts recover
-        } else if (game.tick == game.pill_chomp.tick + 1 + (7 * FPS)) {
+        } else if (is_ticks_after(&game.pill_chomp, 1 + (7 * FPS))) {
             pacman->state = PACMAN_MOVING;
         }
 
         if (pacman->tile.x != curr_tile.x || pacman->tile.y != curr_tile.y) {
             pacman->tile = (v2i){curr_tile.x, curr_tile.y};
 
-            if (has_dot_or_pill) {
-                if (pacman->state == PACMAN_SPEEDING) {
-                    pacman->actor.vel =
-                        (v2){game.level.pacman_panic_dots_speed,
-                             game.level.pacman_panic_dots_speed};
-                } else {
-                    pacman->actor.vel = (v2){game.level.pacman_dots_speed,
-                                             game.level.pacman_dots_speed};
-                }
-            } else {
-                if (pacman->state == PACMAN_SPEEDING) {
-                    pacman->actor.vel = (v2){game.level.pacman_panic_speed,
-                                             game.level.pacman_panic_speed};
-                } else {
-                    pacman->actor.vel =
-                        (v2){game.level.pacman_speed, game.level.pacman_speed};
-                }
-            }
+            pacman->actor.speed =
+                game.level->pacman_speeds[pacman->state == PACMAN_SPEEDING]
+                                         [has_dot_or_pill];
         }
 
         b32 is_dir_same = next_dir == pacman->actor.dir ? 1 : 0;
         v2i next_dir_vec = dir_vectors[next_dir];
-        v2 next_pos = get_next_pos(&pacman->actor.pos, &pacman->actor.vel,
-                                   &next_dir_vec, dt);
+        v2i next_pos = get_next_pos(&pacman->actor.pos, pacman->actor.speed,
+                                    &next_dir_vec);
 
         b32 can_pacman_move = 0;
         // update check
-        if (next_pos.x < TILE_WIDTH) {
-            next_pos.x = (f32)(BACK_BUFFER_WIDTH - TILE_WIDTH - 1);
+        if (next_pos.x < SUBPX(TILE_WIDTH)) {
+            next_pos.x = SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH - 1);
             can_pacman_move = 1;
-        } else if (next_pos.x >= (BACK_BUFFER_WIDTH - TILE_WIDTH)) {
-            next_pos.x = TILE_WIDTH;
+        } else if (next_pos.x >= SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH)) {
+            next_pos.x = SUBPX(TILE_WIDTH);
             can_pacman_move = 1;
         } else {
             can_pacman_move =
@@ -1201,8 +1518,8 @@ internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
             } else {
                 is_dir_same = 1;
                 next_dir_vec = dir_vectors[pacman->actor.dir];
-                next_pos = get_next_pos(&pacman->actor.pos, &pacman->actor.vel,
-                                        &next_dir_vec, dt);
+                next_pos = get_next_pos(&pacman->actor.pos,
+                                        pacman->actor.speed, &next_dir_vec);
                 can_pacman_move =
                     can_move(tile_map, &next_pos, &curr_tile, &curr_tile_pos,
                              &next_dir_vec, is_dir_same);
@@ -1211,51 +1528,57 @@ internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
 
         // update
         if (can_pacman_move) {
-            v2 dist_to_tile_mid = v2_sub(next_pos, curr_tile_pos);
-            v2 dist_to_bonus = v2_sub(next_pos, bonus_pos);
+            v2i dist_to_tile_mid = v2i_sub(next_pos, curr_tile_pos);
+            v2i dist_to_bonus = v2i_sub(next_pos, bonus_pos);
             move(&pacman->actor.pos, &curr_tile_pos, &next_pos, &next_dir_vec,
                  is_dir_same);
 
-            if (game.level.bonus.state == BONUS_ACTIVE &&
+            if (game.bonus_state == BONUS_ACTIVE &&
                 in_range(dist_to_bonus, COLLISION_RANGE)) {
                 after(&game.bonus_collected, 1);
                 after(&game.bonus_point_hide, 1 * FPS);
-                game.score += game.level.bonus.points;
-                PlaySound(game.bonus_sfx);
+                game.score += game.level->bonus.points;
+                PlaySound(audio.bonus_sfx);
             }
             if (curr_tile_type == TILE_DOT ||
                 curr_tile_type == TILE_PILL &&
                     in_range(dist_to_tile_mid, COLLISION_RANGE)) {
                 if (curr_tile_type == TILE_DOT) {
-                    PlaySound(game.chomp_sfx);
+                    PlaySound(audio.chomp_sfx);
                     game.score += 10;
                     game.dots_left -= 1;
                 }
                 if (curr_tile_type == TILE_PILL) {
                     game.score += 50;
-                    game.pill_chomp.tick = game.tick + 1;
+                    after(&game.pill_chomp, 1);
                     game.pills_left -= 1;
                 }
 
                 tile_map[curr_tile.y * SCREEN_TILES_X + curr_tile.x] = 0;
+                game.eaten_tiles_hash ^=
+                    hash_round(0, curr_tile.y * SCREEN_TILES_X + curr_tile.x);
+                if (curr_tile_type == TILE_DOT) {
+                    mark_dot_eaten(curr_tile);
+                }
             }
         } else if (is_dir_same) {
             resolve_wall_collision(&next_pos, &curr_tile_pos, &next_dir_vec);
             pacman->state = PACMAN_IDLE;
         }
 
-        if (game.tick != game.pill_chomp.tick) {
+        if (!is_now(&game.pill_chomp)) {
             for (i32 i = 0; i < GHOST_TYPE_COUNT; i++) {
                 Ghost *ghost = &game.ghosts[i];
-                v2 dist_to_ghost = v2_sub(pacman->actor.pos, ghost->actor.pos);
+                v2i dist_to_ghost =
+                    v2i_sub(pacman->actor.pos, ghost->actor.pos);
                 if (in_range(dist_to_ghost, COLLISION_RANGE)) {
                     if (ghost->state != GHOST_EYES &&
                         ghost->state != GHOST_EATEN &&
                         ghost->state != GHOST_PANIC &&
                         ghost->state != GHOST_RECOVER) {
-                        TraceLog(LOG_DEBUG, "Ghost state: %d\n", ghost->state);
+                        DEBUG_LOG("Ghost state: %d\n", ghost->state);
                         pacman->state = PACMAN_CAUGHT;
-                        TraceLog(LOG_DEBUG, "Pacman CAUGHT!!");
+                        DEBUG_LOG("Pacman CAUGHT!!");
                         game.state = GAME_FROZEN;
                         after(&game.resume, 1 * FPS);
                         after(&game.round_over,
@@ -1265,10 +1588,9 @@ internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
                 }
             }
         }
-    } else if (pacman->state == PACMAN_CAUGHT &&
-               game.tick == game.resume.tick) {
-        PlaySound(game.death_sfx);
-        TraceLog(LOG_DEBUG, "Pacman DEAD!!");
+    } else if (pacman->state == PACMAN_CAUGHT && is_now(&game.resume)) {
+        PlaySound(audio.death_sfx);
+        DEBUG_LOG("Pacman DEAD!!");
         pacman->state = PACMAN_DEAD;
     }
 
@@ -1301,27 +1623,442 @@ internal void update_pacman(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
 
             pacman->anim.frames =
                 sprite_tiles +
-                pacman->anim_indexes_in_sprite[pacman->anim_type];
+                pacman_anim_indexes_in_sprite[pacman->anim_type];
             pacman->anim.frame_count =
-                pacman->anim_frame_counts[pacman->anim_type];
+                pacman_anim_frame_counts[pacman->anim_type];
         }
         update_animation_frame(&pacman->anim);
     }
 }
 
-void update(Rectangle *sprite_tiles, u32 *tile_map, f32 dt) {
+// ==================== SWARM MODE ==================== //
+
+#if SWARM_LANES == 8
+typedef __m256 lane_f32;
+typedef __m256i lane_i32;
+#define lane_load(p) _mm256_load_ps(p)
+#define lane_load_i(p) _mm256_load_si256((lane_i32 *)(p))
+#define lane_store_i(p, v) _mm256_store_si256((lane_i32 *)(p), v)
+#define lane_set1(x) _mm256_set1_ps(x)
+#define lane_set1_i(x) _mm256_set1_epi32(x)
+#define lane_add(a, b) _mm256_add_ps(a, b)
+#define lane_sub(a, b) _mm256_sub_ps(a, b)
+#define lane_mul(a, b) _mm256_mul_ps(a, b)
+#define lane_lt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define lane_and(a, b) _mm256_and_ps(a, b)
+#define lane_andnot(a, b) _mm256_andnot_ps(a, b)
+#define lane_select(m, a, b) _mm256_blendv_ps(b, a, m)
+#define lane_mask(m) _mm256_movemask_ps(m)
+#define lane_add_i(a, b) _mm256_add_epi32(a, b)
+#define lane_sub_i(a, b) _mm256_sub_epi32(a, b)
+#define lane_and_i(a, b) _mm256_and_si256(a, b)
+#define lane_xor_i(a, b) _mm256_xor_si256(a, b)
+#define lane_eq_i(a, b) _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))
+#define lane_gt_i(a, b) _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))
+#define lane_sll_i(a, n) _mm256_slli_epi32(a, n)
+#define lane_srl_i(a, n) _mm256_srli_epi32(a, n)
+#define lane_sra_i(a, n) _mm256_srai_epi32(a, n)
+#define lane_to_f(a) _mm256_cvtepi32_ps(a)
+#define lane_as_f(a) _mm256_castsi256_ps(a)
+#define lane_as_i(a) _mm256_castps_si256(a)
+#define lane_gather_i(base, idx) _mm256_i32gather_epi32((const int *)(base), idx, 4)
+#elif SWARM_LANES == 4
+typedef __m128 lane_f32;
+typedef __m128i lane_i32;
+#define lane_load(p) _mm_load_ps(p)
+#define lane_load_i(p) _mm_load_si128((lane_i32 *)(p))
+#define lane_store_i(p, v) _mm_store_si128((lane_i32 *)(p), v)
+#define lane_set1(x) _mm_set1_ps(x)
+#define lane_set1_i(x) _mm_set1_epi32(x)
+#define lane_add(a, b) _mm_add_ps(a, b)
+#define lane_sub(a, b) _mm_sub_ps(a, b)
+#define lane_mul(a, b) _mm_mul_ps(a, b)
+#define lane_lt(a, b) _mm_cmplt_ps(a, b)
+#define lane_and(a, b) _mm_and_ps(a, b)
+#define lane_andnot(a, b) _mm_andnot_ps(a, b)
+#define lane_select(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#define lane_mask(m) _mm_movemask_ps(m)
+#define lane_add_i(a, b) _mm_add_epi32(a, b)
+#define lane_sub_i(a, b) _mm_sub_epi32(a, b)
+#define lane_and_i(a, b) _mm_and_si128(a, b)
+#define lane_xor_i(a, b) _mm_xor_si128(a, b)
+#define lane_eq_i(a, b) _mm_castsi128_ps(_mm_cmpeq_epi32(a, b))
+#define lane_gt_i(a, b) _mm_castsi128_ps(_mm_cmpgt_epi32(a, b))
+#define lane_sll_i(a, n) _mm_slli_epi32(a, n)
+#define lane_srl_i(a, n) _mm_srli_epi32(a, n)
+#define lane_sra_i(a, n) _mm_srai_epi32(a, n)
+#define lane_to_f(a) _mm_cvtepi32_ps(a)
+#define lane_as_f(a) _mm_castsi128_ps(a)
+#define lane_as_i(a) _mm_castps_si128(a)
+
+// SSE2 has no gather, but the exits table is tiny and stays in L1.
+internal lane_i32 lane_gather_i(const i32 *base, lane_i32 idx) {
+    i32 lanes[4];
+    _mm_storeu_si128((lane_i32 *)lanes, idx);
+    return _mm_set_epi32(base[lanes[3]], base[lanes[2]], base[lanes[1]],
+                         base[lanes[0]]);
+}
+#endif
+
+#if SWARM_LANES > 1
+#define lane_select_i(m, a, b) \
+    lane_as_i(lane_select(m, lane_as_f(a), lane_as_f(b)))
+#endif
+
+// log2(SUBPX(TILE_WIDTH)), tiles are square.
+#define SWARM_TILE_SHIFT (SUBPIXEL_BITS + 3)
+
+global i32 swarm_dir_sprite_offsets[DIR_COUNT] = {4, 2, 6, 0};
+
+internal u32 swarm_rand(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+internal void *swarm_push(u8 **cursor, u32 size) {
+    void *result = *cursor;
+    *cursor += (size + 63) & ~63u;
+    return result;
+}
+
+internal void reset_swarm() {
+    u32 seed = 0x9E3779B9;
+
+    for (u32 i = 0; i < swarm.capacity; i++) {
+        GhostType type = i % GHOST_TYPE_COUNT;
+        i32 tile = swarm.spawn_tiles[swarm_rand(&seed) % swarm.spawn_tile_count];
+        v2i scatter = ghost_scatter_targets[type];
+
+        v2i pos = get_tile_pos((v2i){tile % SCREEN_TILES_X, tile / SCREEN_TILES_X});
+        swarm.pos_x[i] = pos.x;
+        swarm.pos_y[i] = pos.y;
+        // Up to 3 sub-pixels per tick slower than the level's ghost speed so
+        // the swarm spreads out instead of moving in lockstep.
+        swarm.speed_offset[i] = -(i32)(swarm_rand(&seed) % 4);
+        swarm.scatter_x[i] = (f32)scatter.x;
+        swarm.scatter_y[i] = (f32)scatter.y;
+        swarm.chase_offset_x[i] = (f32)((i32)(swarm_rand(&seed) %
+                                              (2 * SWARM_CHASE_SPREAD + 1)) -
+                                        SWARM_CHASE_SPREAD);
+        swarm.chase_offset_y[i] = (f32)((i32)(swarm_rand(&seed) %
+                                              (2 * SWARM_CHASE_SPREAD + 1)) -
+                                        SWARM_CHASE_SPREAD);
+        swarm.dir[i] = swarm_rand(&seed) % DIR_COUNT;
+        swarm.state[i] = GHOST_SCATTER;
+        swarm.last_tile[i] = -1;
+        swarm.rng[i] = swarm_rand(&seed) | 1;
+        swarm.type[i] = (u8)type;
+    }
+}
+
+internal void init_swarm(u32 count) {
+    u32 tile_map[SCREEN_TILES_X * SCREEN_TILES_Y];
+    init_tile_map(tile_map);
+
+    swarm.count = count > SWARM_MAX_GHOSTS ? SWARM_MAX_GHOSTS : count;
+    swarm.capacity =
+        (swarm.count + SWARM_LANES - 1) / SWARM_LANES * SWARM_LANES;
+
+    u32 f32_size = swarm.capacity * sizeof(f32);
+    u8 *cursor =
+        (u8 *)push_size(&permanent_arena, 12 * ((f32_size + 63) & ~63u), 64);
+    swarm.pos_x = swarm_push(&cursor, f32_size);
+    swarm.pos_y = swarm_push(&cursor, f32_size);
+    swarm.speed_offset = swarm_push(&cursor, f32_size);
+    swarm.scatter_x = swarm_push(&cursor, f32_size);
+    swarm.scatter_y = swarm_push(&cursor, f32_size);
+    swarm.chase_offset_x = swarm_push(&cursor, f32_size);
+    swarm.chase_offset_y = swarm_push(&cursor, f32_size);
+    swarm.dir = swarm_push(&cursor, f32_size);
+    swarm.state = swarm_push(&cursor, f32_size);
+    swarm.last_tile = swarm_push(&cursor, f32_size);
+    swarm.rng = swarm_push(&cursor, f32_size);
+    swarm.type = swarm_push(&cursor, f32_size);
+
+    // Swarm ghosts never use the door, so exits only depend on the walls and
+    // can be baked once. Bit `dir` is set when the neighbour in `dir` is open.
+    swarm.spawn_tile_count = 0;
+    for (i32 y = 0; y < SCREEN_TILES_Y; y++) {
+        for (i32 x = 0; x < SCREEN_TILES_X; x++) {
+            i32 tile = y * SCREEN_TILES_X + x;
+            swarm.exits[tile] = 0;
+            for (i32 dir = 0; dir < DIR_COUNT; dir++) {
+                v2i next = v2i_add((v2i){x, y}, dir_vectors[dir]);
+                if (next.x >= 0 && next.x < SCREEN_TILES_X && next.y >= 0 &&
+                    next.y < SCREEN_TILES_Y) {
+                    u32 type = tile_map[next.y * SCREEN_TILES_X + next.x];
+                    if (type != TILE_WALL && type != TILE_DOOR) {
+                        swarm.exits[tile] |= 1 << dir;
+                    }
+                }
+            }
+            if (tile_map[tile] == TILE_DOT || tile_map[tile] == TILE_PILL) {
+                swarm.spawn_tiles[swarm.spawn_tile_count++] = tile;
+            }
+        }
+    }
+
+    TraceLog(LOG_INFO, "SWARM: %u ghosts, %d lanes", swarm.count, SWARM_LANES);
+}
+
+#if SWARM_LANES == 1
+// Scalar version of the steering kernel for targets without SSE2.
+internal void update_swarm_scalar(GhostState mode, v2i pacman_tile,
+                                  i32 step) {
+    for (u32 i = 0; i < swarm.capacity; i++) {
+        if (swarm.state[i] != (i32)mode) {
+            swarm.dir[i] = get_opposite_dir(swarm.dir[i]);
+            swarm.last_tile[i] = -1;
+            swarm.state[i] = mode;
+        }
+
+        v2i pos = {swarm.pos_x[i], swarm.pos_y[i]};
+        v2i tile = get_tile(pos);
+        v2i tile_pos = get_tile_pos(tile);
+        i32 tile_index = tile.y * SCREEN_TILES_X + tile.x;
+
+        if (tile_index != swarm.last_tile[i] &&
+            in_range(v2i_sub(pos, tile_pos), GHOST_CORNERING_RANGE)) {
+            v2 target = {0};
+            if (mode == GHOST_PANIC) {
+                u32 r = swarm_rand(&swarm.rng[i]);
+                target.x = (r >> 16) * (SCREEN_TILES_X / 65536.0f);
+                target.y = (r & 0xFFFF) * (SCREEN_TILES_Y / 65536.0f);
+            } else if (mode == GHOST_SCATTER) {
+                target = (v2){swarm.scatter_x[i], swarm.scatter_y[i]};
+            } else {
+                target = (v2){pacman_tile.x + swarm.chase_offset_x[i],
+                              pacman_tile.y + swarm.chase_offset_y[i]};
+            }
+
+            i32 reverse_dir = get_opposite_dir(swarm.dir[i]);
+            i32 best_dir = swarm.dir[i];
+            f32 best_dist = 1e9f;
+            for (i32 dir = 0; dir < DIR_COUNT; dir++) {
+                if (dir != reverse_dir && (swarm.exits[tile_index] & (1 << dir))) {
+                    f32 dx = tile.x + dir_vectors[dir].x - target.x;
+                    f32 dy = tile.y + dir_vectors[dir].y - target.y;
+                    f32 dist = dx * dx + dy * dy;
+                    if (dist < best_dist) {
+                        best_dist = dist;
+                        best_dir = dir;
+                    }
+                }
+            }
+            if (best_dir != swarm.dir[i]) {
+                pos = tile_pos;
+            }
+            swarm.dir[i] = best_dir;
+            swarm.last_tile[i] = tile_index;
+        }
+
+        i32 ghost_step = step + swarm.speed_offset[i];
+        pos.x += dir_vectors[swarm.dir[i]].x * ghost_step;
+        pos.y += dir_vectors[swarm.dir[i]].y * ghost_step;
+        if (pos.x < SUBPX(TILE_WIDTH)) {
+            pos.x = SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH - 1);
+        } else if (pos.x >= SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH)) {
+            pos.x = SUBPX(TILE_WIDTH);
+        }
+        swarm.pos_x[i] = pos.x;
+        swarm.pos_y[i] = pos.y;
+    }
+}
+#endif
+
+#if SWARM_LANES > 1
+// Same steering as update_swarm_scalar(), SWARM_LANES ghosts at a time. The
+// mode is shared by the whole population so target selection branches once
+// per lane group instead of blending all three targets.
+internal void update_swarm_simd(GhostState mode, v2i pacman_tile, i32 step) {
+    lane_f32 all_ones = lane_as_f(lane_set1_i(-1));
+    lane_i32 half_tile = lane_set1_i(SUBPX(TILE_WIDTH) / 2);
+    lane_i32 cornering_range = lane_set1_i(GHOST_CORNERING_RANGE);
+    lane_i32 neg_cornering_range = lane_set1_i(-GHOST_CORNERING_RANGE);
+    lane_i32 tunnel_entry_left = lane_set1_i(SUBPX(TILE_WIDTH));
+    lane_i32 tunnel_exit_right =
+        lane_set1_i(SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH - 1));
+    lane_i32 tunnel_entry_right =
+        lane_set1_i(SUBPX(BACK_BUFFER_WIDTH - TILE_WIDTH) - 1);
+    lane_i32 tick_step = lane_set1_i(step);
+    lane_f32 pacman_x = lane_set1((f32)pacman_tile.x);
+    lane_f32 pacman_y = lane_set1((f32)pacman_tile.y);
+    lane_f32 random_scale_x = lane_set1(SCREEN_TILES_X / 65536.0f);
+    lane_f32 random_scale_y = lane_set1(SCREEN_TILES_Y / 65536.0f);
+    lane_i32 mode_i = lane_set1_i(mode);
+    lane_i32 two = lane_set1_i(2);
+    lane_i32 three = lane_set1_i(3);
+    lane_i32 low_16 = lane_set1_i(0xFFFF);
+    lane_i32 dir_left = lane_set1_i(DIR_LEFT);
+    lane_i32 dir_right = lane_set1_i(DIR_RIGHT);
+    lane_i32 dir_up = lane_set1_i(DIR_UP);
+    lane_i32 dir_down = lane_set1_i(DIR_DOWN);
+
+    for (u32 i = 0; i < swarm.capacity; i += SWARM_LANES) {
+        lane_i32 pos_x = lane_load_i(swarm.pos_x + i);
+        lane_i32 pos_y = lane_load_i(swarm.pos_y + i);
+        lane_i32 dir = lane_load_i(swarm.dir + i);
+        lane_i32 last_tile = lane_load_i(swarm.last_tile + i);
+
+        lane_f32 changed = lane_andnot(
+            lane_eq_i(lane_load_i(swarm.state + i), mode_i), all_ones);
+        dir = lane_select_i(changed, lane_and_i(lane_add_i(dir, two), three),
+                            dir);
+        last_tile = lane_select_i(changed, lane_set1_i(-1), last_tile);
+        lane_store_i(swarm.state + i, mode_i);
+
+        lane_i32 tile_x = lane_sra_i(pos_x, SWARM_TILE_SHIFT);
+        lane_i32 tile_y = lane_sra_i(pos_y, SWARM_TILE_SHIFT);
+        lane_f32 tile_fx = lane_to_f(tile_x);
+        lane_f32 tile_fy = lane_to_f(tile_y);
+        lane_i32 center_x =
+            lane_add_i(lane_sll_i(tile_x, SWARM_TILE_SHIFT), half_tile);
+        lane_i32 center_y =
+            lane_add_i(lane_sll_i(tile_y, SWARM_TILE_SHIFT), half_tile);
+        lane_i32 dist_x = lane_sub_i(pos_x, center_x);
+        lane_i32 dist_y = lane_sub_i(pos_y, center_y);
+        // tile_y * 30 + tile_x without SSE4.1's 32-bit multiply.
+        lane_i32 tile = lane_add_i(
+            lane_sub_i(lane_sll_i(tile_y, 5), lane_sll_i(tile_y, 1)), tile_x);
+
+        lane_f32 near = lane_and(
+            lane_and(lane_gt_i(cornering_range, dist_x),
+                     lane_gt_i(dist_x, neg_cornering_range)),
+            lane_and(lane_gt_i(cornering_range, dist_y),
+                     lane_gt_i(dist_y, neg_cornering_range)));
+        near = lane_andnot(lane_eq_i(tile, last_tile), near);
+
+        if (lane_mask(near)) {
+            lane_f32 target_x;
+            lane_f32 target_y;
+            if (mode == GHOST_PANIC) {
+                lane_i32 r = lane_load_i(swarm.rng + i);
+                r = lane_xor_i(r, lane_sll_i(r, 13));
+                r = lane_xor_i(r, lane_srl_i(r, 17));
+                r = lane_xor_i(r, lane_sll_i(r, 5));
+                lane_store_i(swarm.rng + i, r);
+                target_x = lane_mul(lane_to_f(lane_srl_i(r, 16)), random_scale_x);
+                target_y = lane_mul(lane_to_f(lane_and_i(r, low_16)),
+                                    random_scale_y);
+            } else if (mode == GHOST_SCATTER) {
+                target_x = lane_load(swarm.scatter_x + i);
+                target_y = lane_load(swarm.scatter_y + i);
+            } else {
+                target_x = lane_add(pacman_x, lane_load(swarm.chase_offset_x + i));
+                target_y = lane_add(pacman_y, lane_load(swarm.chase_offset_y + i));
+            }
+
+            lane_i32 exits = lane_gather_i(swarm.exits, tile);
+            lane_i32 reverse_dir = lane_and_i(lane_add_i(dir, two), three);
+            lane_f32 best_dist = lane_set1(1e9f);
+            lane_i32 best_dir = dir;
+            for (i32 d = 0; d < DIR_COUNT; d++) {
+                lane_i32 d_i = lane_set1_i(d);
+                lane_i32 exit_bit = lane_set1_i(1 << d);
+                lane_f32 open = lane_andnot(
+                    lane_eq_i(reverse_dir, d_i),
+                    lane_eq_i(lane_and_i(exits, exit_bit), exit_bit));
+                lane_f32 dx = lane_sub(
+                    lane_add(tile_fx, lane_set1((f32)dir_vectors[d].x)), target_x);
+                lane_f32 dy = lane_sub(
+                    lane_add(tile_fy, lane_set1((f32)dir_vectors[d].y)), target_y);
+                lane_f32 dist = lane_add(lane_mul(dx, dx), lane_mul(dy, dy));
+                lane_f32 better = lane_and(open, lane_lt(dist, best_dist));
+                best_dist = lane_select(better, dist, best_dist);
+                best_dir = lane_select_i(better, d_i, best_dir);
+            }
+
+            lane_i32 next_dir = lane_select_i(near, best_dir, dir);
+            lane_f32 turned = lane_andnot(lane_eq_i(next_dir, dir), all_ones);
+            pos_x = lane_select_i(turned, center_x, pos_x);
+            pos_y = lane_select_i(turned, center_y, pos_y);
+            last_tile = lane_select_i(near, tile, last_tile);
+            dir = next_dir;
+        }
+
+        // Direction masks pick +step, -step or 0 per axis, no multiplies.
+        lane_i32 lane_step =
+            lane_add_i(tick_step, lane_load_i(swarm.speed_offset + i));
+        pos_x = lane_add_i(
+            pos_x, lane_sub_i(lane_and_i(lane_as_i(lane_eq_i(dir, dir_right)),
+                                         lane_step),
+                              lane_and_i(lane_as_i(lane_eq_i(dir, dir_left)),
+                                         lane_step)));
+        pos_y = lane_add_i(
+            pos_y, lane_sub_i(lane_and_i(lane_as_i(lane_eq_i(dir, dir_down)),
+                                         lane_step),
+                              lane_and_i(lane_as_i(lane_eq_i(dir, dir_up)),
+                                         lane_step)));
+        pos_x = lane_select_i(lane_gt_i(tunnel_entry_left, pos_x),
+                              tunnel_exit_right, pos_x);
+        pos_x = lane_select_i(lane_gt_i(pos_x, tunnel_entry_right),
+                              tunnel_entry_left, pos_x);
+
+        lane_store_i(swarm.pos_x + i, pos_x);
+        lane_store_i(swarm.pos_y + i, pos_y);
+        lane_store_i(swarm.dir + i, dir);
+        lane_store_i(swarm.last_tile + i, last_tile);
+    }
+}
+#endif
+
+internal void update_swarm(TickContext *context) {
+    if (!swarm.count) {
+        return;
+    }
+
+    f64 start = get_seconds();
+    GhostState mode =
+        context->panicking ? GHOST_PANIC : context->schedule_state;
+    i32 step = mode == GHOST_PANIC
+                   ? get_step(&context->level->ghost_panic_speed)
+                   : get_step(&context->level->ghost_speed);
+
+#if SWARM_LANES > 1
+    update_swarm_simd(mode, context->pacman_tile, step);
+#else
+    update_swarm_scalar(mode, context->pacman_tile, step);
+#endif
+
+    swarm.update_time_total += get_seconds() - start;
+    swarm.update_count += 1;
+}
+
+internal void init_round(Rectangle *sprite_tiles) {
+    init_pacman(sprite_tiles);
+    init_ghosts(sprite_tiles);
+    if (swarm.count) {
+        reset_swarm();
+    }
+}
+
+void update(Rectangle *sprite_tiles, u32 *tile_map) {
     PacMan *pacman = &game.pacman;
-    update_pacman(sprite_tiles, tile_map, dt);
+    PROFILE_BEGIN(PROFILE_PACMAN);
+    update_pacman(sprite_tiles, tile_map);
+    PROFILE_END(PROFILE_PACMAN);
     if (pacman->state != PACMAN_DEAD) {
+        TickContext context = prepare_tick();
         for (i32 i = 0; i < GHOST_TYPE_COUNT; i++) {
-            update_ghost(i, sprite_tiles, tile_map, dt);
+            PROFILE_BEGIN(PROFILE_BLINKY + i);
+            update_ghost(i, &context, sprite_tiles, tile_map);
+            PROFILE_END(PROFILE_BLINKY + i);
+            if (i == GHOST_BLINKY) {
+                context.blinky_tile =
+                    get_tile(game.ghosts[GHOST_BLINKY].actor.pos);
+            }
         }
+        PROFILE_BEGIN(PROFILE_SWARM);
+        update_swarm(&context);
+        PROFILE_END(PROFILE_SWARM);
     }
 }
 
-internal void init_level(u32 level_count, Rectangle *sprite_tiles, u32* tile_map) {
-    Level *level = &game.level;
-
+internal void load_level(Level *level, u32 level_count,
+                         Rectangle *sprite_tiles) {
     if (level_count < 2) {
         level->bonus.type = BONUS_CHERRY;
         level->bonus.points = 100;
@@ -1367,51 +2104,52 @@ internal void init_level(u32 level_count, Rectangle *sprite_tiles, u32* tile_map
         level->bonus.points_tile =
             (Rectangle){3 * TILE_WIDTH + 14, 12 * TILE_HEIGHT, 20, TILE_HEIGHT};
     }
-    level->bonus.state = BONUS_INACTIVE;
 
     if (level_count < 2) {
-        level->pacman_speed = MAX_SPEED * 0.8f;
-        level->pacman_dots_speed = MAX_SPEED * 0.71f;
-        level->pacman_panic_speed = MAX_SPEED * 0.9f;
-        level->pacman_panic_dots_speed = MAX_SPEED * 0.79f;
+        level->pacman_speed = get_speed_pattern(800);
+        level->pacman_dots_speed = get_speed_pattern(710);
+        level->pacman_panic_speed = get_speed_pattern(900);
+        level->pacman_panic_dots_speed = get_speed_pattern(790);
     } else if (level_count < 5) {
-        level->pacman_speed = MAX_SPEED * 0.9f;
-        level->pacman_dots_speed = MAX_SPEED * 0.79f;
-        level->pacman_panic_speed = MAX_SPEED * 0.95f;
-        level->pacman_panic_dots_speed = MAX_SPEED * 0.83f;
+        level->pacman_speed = get_speed_pattern(900);
+        level->pacman_dots_speed = get_speed_pattern(790);
+        level->pacman_panic_speed = get_speed_pattern(950);
+        level->pacman_panic_dots_speed = get_speed_pattern(830);
     } else if (level_count < 21) {
-        level->pacman_speed = MAX_SPEED * 1.0f;
-        level->pacman_dots_speed = MAX_SPEED * 0.87f;
-        level->pacman_panic_speed = MAX_SPEED * 1.0f;
-        level->pacman_panic_dots_speed = MAX_SPEED * 0.87f;
+        level->pacman_speed = get_speed_pattern(1000);
+        level->pacman_dots_speed = get_speed_pattern(870);
+        level->pacman_panic_speed = get_speed_pattern(1000);
+        level->pacman_panic_dots_speed = get_speed_pattern(870);
     } else {
-        level->pacman_speed = MAX_SPEED * 0.9f;
-        level->pacman_dots_speed = MAX_SPEED * 0.79f;
-        level->pacman_panic_speed = MAX_SPEED * 1.0f;
-        level->pacman_panic_dots_speed = MAX_SPEED * 0.87f;
+        level->pacman_speed = get_speed_pattern(900);
+        level->pacman_dots_speed = get_speed_pattern(790);
+        level->pacman_panic_speed = get_speed_pattern(1000);
+        level->pacman_panic_dots_speed = get_speed_pattern(870);
     }
 
+    u32 ghost_speed_permille = 0;
     if (level_count < 2) {
-        level->ghost_speed = MAX_SPEED * 0.75f;
-        level->ghost_tunnel_speed = MAX_SPEED * 0.4f;
-        level->ghost_panic_speed = MAX_SPEED * 0.5f;
-        level->elroy1_speed = MAX_SPEED * 0.8f;
-        level->elroy2_speed = MAX_SPEED * 0.85f;
+        ghost_speed_permille = 750;
+        level->ghost_tunnel_speed = get_speed_pattern(400);
+        level->ghost_panic_speed = get_speed_pattern(500);
+        level->elroy1_speed = get_speed_pattern(800);
+        level->elroy2_speed = get_speed_pattern(850);
     } else if (level_count < 5) {
-        level->ghost_speed = MAX_SPEED * 0.85f;
-        level->ghost_tunnel_speed = MAX_SPEED * 0.45f;
-        level->ghost_panic_speed = MAX_SPEED * 0.55f;
-        level->elroy1_speed = MAX_SPEED * 0.90f;
-        level->elroy2_speed = MAX_SPEED * 0.95f;
+        ghost_speed_permille = 850;
+        level->ghost_tunnel_speed = get_speed_pattern(450);
+        level->ghost_panic_speed = get_speed_pattern(550);
+        level->elroy1_speed = get_speed_pattern(900);
+        level->elroy2_speed = get_speed_pattern(950);
     } else {
-        level->ghost_speed = MAX_SPEED * 0.95f;
-        level->ghost_tunnel_speed = MAX_SPEED * 0.5f;
-        level->ghost_panic_speed = MAX_SPEED * 0.6f;
-        level->elroy1_speed = MAX_SPEED * 1.0f;
-        level->elroy2_speed = MAX_SPEED * 1.05f;
+        ghost_speed_permille = 950;
+        level->ghost_tunnel_speed = get_speed_pattern(500);
+        level->ghost_panic_speed = get_speed_pattern(600);
+        level->elroy1_speed = get_speed_pattern(1000);
+        level->elroy2_speed = get_speed_pattern(1050);
     }
-    level->ghost_home_speed = level->ghost_speed * 0.5f;
-    level->ghost_eyes_speed = level->ghost_speed * 1.5f;
+    level->ghost_speed = get_speed_pattern(ghost_speed_permille);
+    level->ghost_home_speed = get_speed_pattern(ghost_speed_permille / 2);
+    level->ghost_eyes_speed = get_speed_pattern(ghost_speed_permille * 3 / 2);
 
     if (level_count < 2) {
         level->elroy1_dots_left = 20;
@@ -1490,11 +2228,66 @@ internal void init_level(u32 level_count, Rectangle *sprite_tiles, u32* tile_map
         level->inky_dot_limit = 0;
         level->clyde_dot_limit = 60;
     }
+}
+
+// Ghosts at home, recovering or eaten keep the speed they had, their entries
+// are 0.
+internal void build_speed_tables(Level *level) {
+    for (u32 state = 0; state < GHOST_STATE_COUNT; state++) {
+        for (u32 tunnel = 0; tunnel < 2; tunnel++) {
+            for (u32 elroy = 0; elroy < ELROY_COUNT; elroy++) {
+                SpeedPattern *speed = 0;
+                switch (state) {
+                    case GHOST_CHASE:
+                    case GHOST_SCATTER:
+                        speed = tunnel ? &level->ghost_tunnel_speed
+                                       : &level->ghost_speed;
+                        if (elroy == ELROY_1) {
+                            speed = &level->elroy1_speed;
+                        } else if (elroy == ELROY_2) {
+                            speed = &level->elroy2_speed;
+                        }
+                        break;
+                    case GHOST_PANIC:
+                        speed = &level->ghost_panic_speed;
+                        break;
+                    case GHOST_EYES:
+                    case GHOST_ENTER_HOME:
+                        speed = &level->ghost_eyes_speed;
+                        break;
+                    case GHOST_LEAVE_HOME:
+                        speed = &level->ghost_home_speed;
+                        break;
+                }
+                level->ghost_speeds[state][tunnel][elroy] = speed;
+            }
+        }
+    }
+
+    level->pacman_speeds[0][0] = &level->pacman_speed;
+    level->pacman_speeds[0][1] = &level->pacman_dots_speed;
+    level->pacman_speeds[1][0] = &level->pacman_panic_speed;
+    level->pacman_speeds[1][1] = &level->pacman_panic_dots_speed;
+}
+
+internal void load_levels(Rectangle *sprite_tiles) {
+    for (u32 i = 0; i < LEVEL_TUNING_COUNT; i++) {
+        load_level(&levels[i], i + 1, sprite_tiles);
+        build_speed_tables(&levels[i]);
+    }
+}
 
+internal void init_level(u32 level_count, u32 *tile_map) {
+    u32 tuning = level_count < LEVEL_TUNING_COUNT ? level_count
+                                                  : LEVEL_TUNING_COUNT;
+    game.level = &levels[tuning - 1];
+    game.bonus_state = BONUS_INACTIVE;
     game.dots_left = DOT_COUNT;
     game.pills_left = PILL_COUNT;
     if (game.state == GAME_LEVEL_COMPLETE) {
         init_tile_map(tile_map);
+        game.eaten_tiles_hash = 0;
+        game.dot_changes.refilled = 1;
     }
 }
 
@@ -1505,80 +2298,6 @@ internal void load_ghost(GhostType type) {
     ghost->actor.half_dim =
         (v2){SPRITE_TILE_WIDTH * 0.5, SPRITE_TILE_HEIGHT * 0.5};
     ghost->actor.cornering_range = GHOST_CORNERING_RANGE;
-
-    ghost->anim_indexes_in_sprite[GHOST_PANICKING] = 4 * SPRITE_TILES_X + 8;
-    ghost->anim_indexes_in_sprite[GHOST_RECOVERING] = 4 * SPRITE_TILES_X + 8;
-
-    ghost->anim_indexes_in_sprite[GHOST_EYES_LEFT] = 5 * SPRITE_TILES_X + 9;
-    ghost->anim_indexes_in_sprite[GHOST_EYES_RIGHT] = 5 * SPRITE_TILES_X + 8;
-    ghost->anim_indexes_in_sprite[GHOST_EYES_UP] = 5 * SPRITE_TILES_X + 10;
-    ghost->anim_indexes_in_sprite[GHOST_EYES_DOWN] = 5 * SPRITE_TILES_X + 11;
-
-    ghost->anim_indexes_in_sprite[GHOST_EATEN_200] = 8 * SPRITE_TILES_X;
-    ghost->anim_indexes_in_sprite[GHOST_EATEN_400] = 8 * SPRITE_TILES_X + 1;
-    ghost->anim_indexes_in_sprite[GHOST_EATEN_800] = 8 * SPRITE_TILES_X + 2;
-    ghost->anim_indexes_in_sprite[GHOST_EATEN_1600] = 8 * SPRITE_TILES_X + 3;
-
-    ghost->anim_frame_counts[GHOST_GOING_LEFT] = GHOST_MOVE_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_GOING_RIGHT] = GHOST_MOVE_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_GOING_UP] = GHOST_MOVE_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_GOING_DOWN] = GHOST_MOVE_ANIM_FRAME_COUNT;
-
-    ghost->anim_frame_counts[GHOST_PANICKING] = GHOST_PANIC_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_RECOVERING] = GHOST_RECOVER_ANIM_FRAME_COUNT;
-
-    ghost->anim_frame_counts[GHOST_EYES_LEFT] = GHOST_EYES_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EYES_RIGHT] = GHOST_EYES_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EYES_DOWN] = GHOST_EYES_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EYES_UP] = GHOST_EYES_ANIM_FRAME_COUNT;
-
-    ghost->anim_frame_counts[GHOST_EATEN_200] = GHOST_EATEN_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EATEN_400] = GHOST_EATEN_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EATEN_800] = GHOST_EATEN_ANIM_FRAME_COUNT;
-    ghost->anim_frame_counts[GHOST_EATEN_1600] = GHOST_EATEN_ANIM_FRAME_COUNT;
-
-    switch (ghost->type) {
-        case GHOST_BLINKY:
-            ghost->anim_indexes_in_sprite[GHOST_GOING_LEFT] =
-                4 * SPRITE_TILES_X + 2;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_RIGHT] =
-                4 * SPRITE_TILES_X + 0;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_UP] =
-                4 * SPRITE_TILES_X + 4;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_DOWN] =
-                4 * SPRITE_TILES_X + 6;
-            break;
-        case GHOST_PINKY:
-            ghost->anim_indexes_in_sprite[GHOST_GOING_LEFT] =
-                5 * SPRITE_TILES_X + 2;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_RIGHT] =
-                5 * SPRITE_TILES_X + 0;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_UP] =
-                5 * SPRITE_TILES_X + 4;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_DOWN] =
-                5 * SPRITE_TILES_X + 6;
-            break;
-        case GHOST_INKY:
-            ghost->anim_indexes_in_sprite[GHOST_GOING_LEFT] =
-                6 * SPRITE_TILES_X + 2;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_RIGHT] =
-                6 * SPRITE_TILES_X + 0;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_UP] =
-                6 * SPRITE_TILES_X + 4;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_DOWN] =
-                6 * SPRITE_TILES_X + 6;
-            break;
-        case GHOST_CLYDE:
-            ghost->anim_indexes_in_sprite[GHOST_GOING_LEFT] =
-                7 * SPRITE_TILES_X + 2;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_RIGHT] =
-                7 * SPRITE_TILES_X + 0;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_UP] =
-                7 * SPRITE_TILES_X + 4;
-            ghost->anim_indexes_in_sprite[GHOST_GOING_DOWN] =
-                7 * SPRITE_TILES_X + 6;
-            break;
-    }
 }
 
 internal void load_pacman() {
@@ -1587,526 +2306,2772 @@ internal void load_pacman() {
     pacman->actor.half_dim =
         (v2){SPRITE_TILE_WIDTH * 0.5, SPRITE_TILE_HEIGHT * 0.5};
     pacman->actor.cornering_range = PACMAN_CORNERING_RANGE;
+}
 
-    pacman->anim_indexes_in_sprite[PACMAN_IDLING] = 0;
-    pacman->anim_indexes_in_sprite[PACMAN_GOING_LEFT] = 4;
-    pacman->anim_indexes_in_sprite[PACMAN_GOING_RIGHT] = 0;
-    pacman->anim_indexes_in_sprite[PACMAN_GOING_UP] = 8;
-    pacman->anim_indexes_in_sprite[PACMAN_GOING_DOWN] = 12;
-    pacman->anim_indexes_in_sprite[PACMAN_DYING] = 16;
+// ==================== RENDERING ==================== //
 
-    pacman->anim_frame_counts[PACMAN_IDLING] = PACMAN_IDLE_ANIM_FRAME_COUNT;
-    pacman->anim_frame_counts[PACMAN_GOING_LEFT] = PACMAN_MOVE_ANIM_FRAME_COUNT;
-    pacman->anim_frame_counts[PACMAN_GOING_RIGHT] =
-        PACMAN_MOVE_ANIM_FRAME_COUNT;
-    pacman->anim_frame_counts[PACMAN_GOING_UP] = PACMAN_MOVE_ANIM_FRAME_COUNT;
-    pacman->anim_frame_counts[PACMAN_GOING_DOWN] = PACMAN_MOVE_ANIM_FRAME_COUNT;
-    pacman->anim_frame_counts[PACMAN_DYING] = PACMAN_DIE_ANIM_FRAME_COUNT;
+internal SoftImage push_soft_image(Arena *arena, i32 width, i32 height) {
+    SoftImage result = {0};
+    result.width = width;
+    result.height = height;
+    result.pixels = push_array(arena, u32, width * height);
+    return result;
 }
 
-internal void init_game() {
-    game.tick = 0;
-    game.rounds_left = ROUND_COUNT;
-    game.score = 0;
-    game.level_count = 0;
-
-    game.load.tick = DISABLED_TICK;
-    game.prelude.tick = DISABLED_TICK;
-    game.ready.tick = DISABLED_TICK;
-    game.play.tick = DISABLED_TICK;
-    game.pill_chomp.tick = DISABLED_TICK;
-    game.ghost_start_recovery.tick = DISABLED_TICK;
-    game.ghost_recover.tick = DISABLED_TICK;
-    game.freeze.tick = DISABLED_TICK;
-    game.resume.tick = DISABLED_TICK;
-    game.round_over.tick = DISABLED_TICK;
-    game.level_complete.tick = DISABLED_TICK;
-    game.unload.tick = DISABLED_TICK;
-    game.bonus_timeup.tick = DISABLED_TICK;
-    game.bonus_collected.tick = DISABLED_TICK;
-    game.bonus_point_hide.tick = DISABLED_TICK;
-}
-
-i32 main(void) {
-    SetTraceLogCallback(trace_log_callback);
-    SetTraceLogLevel(LOG_DEBUG);
+internal void load_renderer(RenderBackend backend, b32 headless) {
+    renderer.backend = backend;
+    renderer.batch.commands =
+        push_array(&permanent_arena, DrawCommand, DRAW_COMMAND_CAPACITY);
+    renderer.batch.sorted =
+        push_array(&permanent_arena, DrawCommand, DRAW_COMMAND_CAPACITY);
+    renderer.compositor.bounds =
+        push_array(&permanent_arena, SoftRect, DRAW_COMMAND_CAPACITY);
+    const char *texture_paths[TEXTURE_COUNT] = {"assets/atlas.png"};
+
+    if (backend == RENDER_SOFTWARE) {
+        for (i32 i = 0; i < TEXTURE_COUNT; i++) {
+            Image image = LoadImage(texture_paths[i]);
+            renderer.images[i] = soft_load_image(image);
+            UnloadImage(image);
+        }
 
-    u32 screen_width = (u32)(BACK_BUFFER_WIDTH * SCALE);
-    u32 screen_height = (u32)(BACK_BUFFER_HEIGHT * SCALE);
+        renderer.frame = push_soft_image(&permanent_arena, BACK_BUFFER_WIDTH,
+                                         BACK_BUFFER_HEIGHT);
+        soft_clear(&renderer.frame, BLACK);
+        renderer.soft_dot_layer = push_soft_image(
+            &permanent_arena, BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+        soft_clear(&renderer.soft_dot_layer, BLANK);
+        renderer.soft_hud_layer = push_soft_image(
+            &permanent_arena, BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+        renderer.target = &renderer.frame;
+        if (!headless) {
+            renderer.frame_tex =
+                LoadTextureFromImage(soft_to_image(&renderer.frame));
+        }
+        TraceLog(LOG_INFO, "RENDER: software backend");
+    } else {
+        for (i32 i = 0; i < TEXTURE_COUNT; i++) {
+            renderer.textures[i] = LoadTexture(texture_paths[i]);
+        }
+        renderer.back_buffer =
+            LoadRenderTexture(BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+        renderer.dot_layer =
+            LoadRenderTexture(BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+        renderer.hud_layer =
+            LoadRenderTexture(BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+    }
+}
 
-    InitWindow(screen_width, screen_height, "pacman0");
-    InitAudioDevice();
-    SetTargetFPS(FPS);
+// The software backend clips to clip, the GPU relies on the scissor rect.
+internal void execute_draw_command(DrawCommand *command, SoftRect clip) {
+    if (renderer.backend == RENDER_SOFTWARE) {
+        SoftImage *image;
+        if (command->source == BATCH_DOTS) {
+            image = &renderer.soft_dot_layer;
+        } else if (command->source == BATCH_HUD) {
+            image = &renderer.soft_hud_layer;
+        } else {
+            image = &renderer.images[command->source];
+        }
+        soft_draw_image_clipped(renderer.target, image, command->rec,
+                                command->pos, command->tint, clip);
+    } else {
+        Texture2D texture;
+        if (command->source == BATCH_DOTS) {
+            texture = renderer.dot_layer.texture;
+        } else if (command->source == BATCH_HUD) {
+            texture = renderer.hud_layer.texture;
+        } else {
+            texture = renderer.textures[command->source];
+        }
+        DrawTextureRec(texture, command->rec, command->pos, command->tint);
+    }
+}
 
-    Texture2D sprite_tex = LoadTexture("assets/sprite.png");
-    Texture2D maze_tex = LoadTexture("assets/maze.png");
-    RenderTexture2D back_buffer =
-        LoadRenderTexture(BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT);
+internal void sort_batch() {
+    SpriteBatch *batch = &renderer.batch;
 
-    Font font = LoadFontEx("assets/PressStart2P.ttf", 16, 0, 0);
+    u32 offsets[LAYER_COUNT * BATCH_SOURCE_COUNT] = {0};
+    for (u32 i = 0; i < batch->count; i++) {
+        DrawCommand *command = &batch->commands[i];
+        offsets[command->layer * BATCH_SOURCE_COUNT + command->source]++;
+    }
+    u32 total = 0;
+    for (u32 key = 0; key < LAYER_COUNT * BATCH_SOURCE_COUNT; key++) {
+        u32 count = offsets[key];
+        offsets[key] = total;
+        total += count;
+    }
+    for (u32 i = 0; i < batch->count; i++) {
+        DrawCommand *command = &batch->commands[i];
+        u32 key = command->layer * BATCH_SOURCE_COUNT + command->source;
+        batch->sorted[offsets[key]++] = *command;
+    }
+}
 
-    Sound prelude = LoadSound("assets/prelude.wav");
+// The GPU back buffer is only bound once something is drawn into it, so an
+// unchanged frame makes no GL calls at all.
+internal void bind_back_buffer() {
+    if (renderer.backend != RENDER_SOFTWARE && !renderer.back_buffer_bound) {
+        BeginTextureMode(renderer.back_buffer);
+        renderer.back_buffer_bound = 1;
+    }
+}
 
-    game.tick = 0;
-    game.state = GAME_INTRO;
-    game.xorshift = 0x12345678;
-    init_game(&prelude);
-
-    v2 maze_start_corner = {TILE_WIDTH, SCORE_TILE_ROW_COUNT * TILE_HEIGHT};
-    u32 *tile_map = get_tile_map();
-    Rectangle *sprite_tiles = get_sprite_tiles();
-    Rectangle *maze_tiles = get_maze_tiles();
-
-    load_pacman();
-    PacMan *pacman = &game.pacman;
-    game.chomp_sfx = LoadSound("assets/chomp.wav");
-    game.death_sfx = LoadSound("assets/death.wav");
-    game.bonus_sfx = LoadSound("assets/bonus.wav");
-    game.ghost_eat_sfx = LoadSound("assets/ghost_eat.wav");
-    game.siren_bgm = LoadMusicStream("assets/siren.wav");
-    game.power_pellet_bgm = LoadMusicStream("assets/power_pellet.wav");
+internal SoftRect get_render_target_rect() {
+    if (renderer.backend == RENDER_SOFTWARE) {
+        return (SoftRect){0, 0, renderer.target->width,
+                          renderer.target->height};
+    }
+    return (SoftRect){0, 0, BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT};
+}
 
-    for (i32 i = 0; i < GHOST_TYPE_COUNT; i++) {
-        load_ghost(i);
+internal void clear_render_target(SoftRect rect) {
+    if (renderer.backend == RENDER_SOFTWARE) {
+        soft_clear_rect(renderer.target, rect.x0, rect.y0, rect.x1 - rect.x0,
+                        rect.y1 - rect.y0, BLACK);
+    } else {
+        ClearBackground(BLACK);
     }
+}
 
-    Ghost *blinky = &game.ghosts[GHOST_BLINKY];
-    Ghost *pinky = &game.ghosts[GHOST_PINKY];
-    Ghost *inky = &game.ghosts[GHOST_INKY];
-    Ghost *clyde = &game.ghosts[GHOST_CLYDE];
+// Draws everything queued, in sorted order and without dirty tracking.
+internal void flush_batch() {
+    SpriteBatch *batch = &renderer.batch;
+    sort_batch();
 
-    Rectangle *dot_image = sprite_tiles + (3 * SPRITE_TILES_X);
-    Animation pill_anim = {0};
-    pill_anim.frames = sprite_tiles + (3 * SPRITE_TILES_X + 2);
-    pill_anim.frame_count = 2;
-    pill_anim.frame_counter = 0;
-    pill_anim.ticks_per_anim_frame = PILL_TICKS_PER_ANIM_FRAME;
-    pill_anim.frame_index = 0;
-    Rectangle *life_indicator = sprite_tiles + (2 * SPRITE_TILES_X + 13);
+    SoftRect clip = get_render_target_rect();
+    for (u32 i = 0; i < batch->count; i++) {
+        if (i == 0 || batch->sorted[i].source != batch->sorted[i - 1].source) {
+            batch->run_total++;
+        }
+        execute_draw_command(&batch->sorted[i], clip);
+    }
 
-    Animation maze_anim = {0};
-    maze_anim.frames = maze_tiles;
-    maze_anim.frame_count = 2;
-    maze_anim.frame_counter = 0;
-    maze_anim.ticks_per_anim_frame = MAZE_TICKS_PER_ANIM_FRAME;
-    maze_anim.frame_index = 0;
+    batch->count = 0;
+}
 
-    Animation press_any_key_anim = {0};
-    press_any_key_anim.frame_count = 2;
-    press_any_key_anim.frame_counter = 0;
-    press_any_key_anim.ticks_per_anim_frame = PRESS_ANY_KEY_TICKS_PER_ANIM_FRAME;
-    press_any_key_anim.frame_index = 0;
+// Pixels a draw can touch, rounded outwards.
+internal SoftRect get_draw_bounds(DrawCommand *command) {
+    SoftRect result;
+    result.x0 = (i32)floorf(command->pos.x);
+    result.y0 = (i32)floorf(command->pos.y);
+    result.x1 = (i32)ceilf(command->pos.x + fabsf(command->rec.width));
+    result.y1 = (i32)ceilf(command->pos.y + fabsf(command->rec.height));
+    if (result.x0 < 0) {
+        result.x0 = 0;
+    }
+    if (result.y0 < 0) {
+        result.y0 = 0;
+    }
+    if (result.x1 > BACK_BUFFER_WIDTH) {
+        result.x1 = BACK_BUFFER_WIDTH;
+    }
+    if (result.y1 > BACK_BUFFER_HEIGHT) {
+        result.y1 = BACK_BUFFER_HEIGHT;
+    }
+    return result;
+}
 
-    f32 alpha = 0.0f;
-    while (!WindowShouldClose()) {
-#if DEBUG
-        f32 dt = TIME_PER_FRAME;
-#else
-        f32 dt = GetFrameTime();
-#endif
-        if (game.state == GAME_INTRO) {
-            if (GetKeyPressed() != 0) {
-                game.state = GAME_LOAD;
-                game.load.tick = game.tick + 30;
-                init_tile_map(tile_map);
+// Merges the dirty cells into rectangles: runs of cells along each row, which
+// grow downwards while the rows below have the same run.
+internal void build_dirty_rects(b32 *dirty) {
+    Compositor *compositor = &renderer.compositor;
+    compositor->rect_count = 0;
+    for (i32 y = 0; y < DIRTY_CELLS_Y; y++) {
+        for (i32 x = 0; x < DIRTY_CELLS_X;) {
+            if (!dirty[y * DIRTY_CELLS_X + x]) {
+                x++;
+                continue;
+            }
+            i32 run_start = x;
+            while (x < DIRTY_CELLS_X && dirty[y * DIRTY_CELLS_X + x]) {
+                x++;
             }
 
-            if (game.tick <= 30) {
-                alpha += 0.033333f;
-            } else {
-                alpha = 1.0f;
+            SoftRect rect = {run_start * DIRTY_CELL_SIZE, y * DIRTY_CELL_SIZE,
+                             x * DIRTY_CELL_SIZE, (y + 1) * DIRTY_CELL_SIZE};
+            b32 merged = 0;
+            for (u32 i = 0; i < compositor->rect_count && !merged; i++) {
+                SoftRect *above = &compositor->rects[i];
+                if (above->x0 == rect.x0 && above->x1 == rect.x1 &&
+                    above->y1 == rect.y0) {
+                    above->y1 = rect.y1;
+                    merged = 1;
+                }
             }
-        } else if (game.state == GAME_LOAD) {
-            if (game.tick < game.load.tick) {
-                alpha -= 0.033333f;
-            } else if (game.tick == game.load.tick) {
-                alpha = 0.0f;
-                game.tick = 0;
-                game.state = GAME_PRELUDE;
-                after(&game.ready, 2 * FPS);
-                PlaySound(prelude);
+            if (!merged) {
+                compositor->rects[compositor->rect_count++] = rect;
             }
-        } else if (game.state == GAME_UNLOAD) {
-            alpha -= 0.033333f;
-            if (game.tick >= (game.unload.tick + 30)) {
-                game.state = GAME_INTRO;
-                init_game();
+        }
+    }
+}
+
+// Redraws only the parts of the back buffer whose draws changed.
+internal void compose_frame() {
+    SpriteBatch *batch = &renderer.batch;
+    Compositor *compositor = &renderer.compositor;
+    sort_batch();
+
+    u64 cells[DIRTY_CELL_COUNT] = {0};
+    for (u32 i = 0; i < batch->count; i++) {
+        DrawCommand *command = &batch->sorted[i];
+        SoftRect bounds = get_draw_bounds(command);
+        compositor->bounds[i] = bounds;
+        if (bounds.x0 >= bounds.x1 || bounds.y0 >= bounds.y1) {
+            continue;
+        }
+
+        u64 version = 0;
+        if (command->source == BATCH_DOTS) {
+            version = compositor->dot_version;
+        } else if (command->source == BATCH_HUD) {
+            version = compositor->hud_version;
+        }
+        u64 signature = hash64(&command->rec, sizeof(command->rec),
+                               version << 16 | command->layer << 8 |
+                                   command->source);
+        signature = hash64(&command->pos, sizeof(command->pos), signature);
+        signature = hash64(&command->tint, sizeof(command->tint), signature);
+
+        for (i32 y = bounds.y0 / DIRTY_CELL_SIZE;
+             y <= (bounds.y1 - 1) / DIRTY_CELL_SIZE; y++) {
+            for (i32 x = bounds.x0 / DIRTY_CELL_SIZE;
+                 x <= (bounds.x1 - 1) / DIRTY_CELL_SIZE; x++) {
+                u64 *cell = &cells[y * DIRTY_CELLS_X + x];
+                *cell = (*cell ^ signature) * HASH_PRIME_1;
             }
-        } else if (game.state == GAME_PRELUDE && game.tick <= 30) {
-            if (game.tick < 30) {
-                alpha += 0.033333f;
-            } else if (game.tick == 30) {
-                alpha = 1.0f;
+        }
+    }
+
+    b32 dirty[DIRTY_CELL_COUNT];
+    for (u32 i = 0; i < DIRTY_CELL_COUNT; i++) {
+        dirty[i] = !compositor->valid || cells[i] != compositor->cells[i];
+        compositor->cells[i] = cells[i];
+    }
+    compositor->valid = 1;
+    build_dirty_rects(dirty);
+    if (compositor->rect_count) {
+        bind_back_buffer();
+    }
+
+    for (u32 r = 0; r < compositor->rect_count; r++) {
+        SoftRect rect = compositor->rects[r];
+        compositor->dirty_pixel_total +=
+            (u64)((rect.x1 - rect.x0) * (rect.y1 - rect.y0));
+        if (renderer.backend != RENDER_SOFTWARE) {
+            BeginScissorMode(rect.x0, rect.y0, rect.x1 - rect.x0,
+                             rect.y1 - rect.y0);
+        }
+        clear_render_target(rect);
+
+        i32 prev_source = -1;
+        for (u32 i = 0; i < batch->count; i++) {
+            SoftRect bounds = compositor->bounds[i];
+            if (bounds.x0 >= rect.x1 || bounds.x1 <= rect.x0 ||
+                bounds.y0 >= rect.y1 || bounds.y1 <= rect.y0) {
+                continue;
             }
-        } else {
-            if (game.tick == game.unload.tick) {
-                game.state = GAME_UNLOAD;
-            } else if (game.tick == game.freeze.tick) {
-                game.state = GAME_FROZEN;
-            } else if (game.tick == game.pill_chomp.tick) {
-                game.ghost_eaten_count = 0;
-                StopMusicStream(game.siren_bgm);
-                PlayMusicStream(game.power_pellet_bgm);
-            } else if (game.tick == game.play.tick ||
-                    game.tick == game.resume.tick) {
-                TraceLog(LOG_DEBUG, "START / RESUME!");
-                game.state = GAME_IN_PROGRESS;
-                PlayMusicStream(game.siren_bgm);
-            } else if (game.tick == game.ready.tick) {
-                if (game.state == GAME_LEVEL_COMPLETE ||
-                        game.state == GAME_PRELUDE) {
-                    game.level_count += 1;
-                    init_level(game.level_count, sprite_tiles, tile_map);
-                    init_round(sprite_tiles);
-                }
-                if (game.state == GAME_ROUND_OVER ||
-                    game.state == GAME_PRELUDE) {
-                    game.rounds_left -= 1;
-                }
-                if (game.state == GAME_ROUND_OVER) {
-                    init_round(sprite_tiles);
-                }
-                game.state = GAME_READY;
-                after(&game.play, 3 * FPS);
-            } else if (game.tick == game.round_over.tick) {
-                game.state = GAME_ROUND_OVER;
-                after(&game.ready, 2 * FPS);
-            } else if (game.tick == game.level_complete.tick) {
-                game.state = GAME_LEVEL_COMPLETE;
-                after(&game.ready, 16 * MAZE_TICKS_PER_ANIM_FRAME);
-            } else if (game.pills_left == 0 && game.dots_left == 0 &&
-                    game.state == GAME_IN_PROGRESS) {
-                game.state = GAME_FROZEN;
-                after(&game.level_complete, 1 * FPS);
+            if (batch->sorted[i].source != prev_source) {
+                prev_source = batch->sorted[i].source;
+                batch->run_total++;
             }
+            execute_draw_command(&batch->sorted[i], rect);
+        }
 
-            u32 total_dots_eatens =
-                (DOT_COUNT + PILL_COUNT) - (game.dots_left + game.pills_left);
+        if (renderer.backend != RENDER_SOFTWARE) {
+            EndScissorMode();
+        }
+    }
 
-            if (total_dots_eatens == 70 || total_dots_eatens == 170) {
-                game.level.bonus.state = BONUS_ACTIVE;
-                after(&game.bonus_timeup, 10 * FPS);
-            }
+    if (compositor->rect_count) {
+        compositor->unchanged_frames = 0;
+    } else {
+        compositor->unchanged_frames++;
+    }
+    batch->count = 0;
+}
 
-            if (game.tick == game.bonus_collected.tick) {
-                game.bonus_timeup.tick = DISABLED_TICK;
-                game.level.bonus.state = BONUS_POINTS;
-            }
+internal DrawCommand *push_draw_command(u8 source, Rectangle rec, v2 pos,
+                                        Color tint) {
+    SpriteBatch *batch = &renderer.batch;
+    if (batch->count == DRAW_COMMAND_CAPACITY) {
+        Compositor *compositor = &renderer.compositor;
+        if (compositor->composing) {
+            // Too many draws to track, redraw the whole frame in order.
+            compositor->composing = 0;
+            compositor->valid = 0;
+            compositor->unchanged_frames = 0;
+            bind_back_buffer();
+            clear_render_target(get_render_target_rect());
+        }
+        flush_batch();
+    }
+    DrawCommand *command = &batch->commands[batch->count++];
+    *command = (DrawCommand){0};
+    command->layer = (u8)batch->layer;
+    command->source = source;
+    command->rec = rec;
+    command->pos = pos;
+    command->tint = tint;
+    return command;
+}
 
-            if (game.tick == game.bonus_timeup.tick ||
-                game.tick == game.bonus_point_hide.tick) {
-                game.level.bonus.state = BONUS_INACTIVE;
-            }
+internal void set_draw_layer(DrawLayer layer) { renderer.batch.layer = layer; }
 
-            if (game.rounds_left < 0 && game.state != GAME_OVER &&
-                game.state != GAME_UNLOAD) {
-                game.state = GAME_OVER;
-                after(&game.unload, 2 * FPS);
-            }
+internal void begin_frame() {
+    renderer.batch.layer = LAYER_HUD;
+    renderer.compositor.composing = 1;
+    if (renderer.backend == RENDER_SOFTWARE) {
+        renderer.frame_start_time = get_seconds();
+    }
+}
+
+internal void end_frame() {
+    if (renderer.compositor.composing) {
+        compose_frame();
+        renderer.compositor.composing = 0;
+    } else {
+        flush_batch();
+    }
+    renderer.batch.frame_count++;
+    if (renderer.backend == RENDER_SOFTWARE) {
+        renderer.soft_time_total += get_seconds() - renderer.frame_start_time;
+        renderer.soft_frame_count++;
+    } else if (renderer.back_buffer_bound) {
+        EndTextureMode();
+        renderer.back_buffer_bound = 0;
+    }
+}
+
+internal void draw_texture_rec(TextureId texture, Rectangle source, v2 pos,
+                               Color tint) {
+    push_draw_command((u8)texture, source, pos, tint);
+}
+
+// Text is drawn glyph by glyph from the atlas, which has the font baked at
+// every size used.
+internal void draw_text(const char *text, v2 pos, i32 size, Color tint) {
+    AtlasFont *font = &atlas_fonts[0];
+    for (i32 i = 0; i < ATLAS_FONT_COUNT; i++) {
+        if (atlas_fonts[i].size == size) {
+            font = &atlas_fonts[i];
+        }
+    }
+
+    for (const char *c = text; *c; c++) {
+        i32 index = *c - ATLAS_FIRST_GLYPH;
+        if (index < 0 || index >= ATLAS_GLYPH_COUNT) {
+            index = '?' - ATLAS_FIRST_GLYPH;
+        }
+        AtlasGlyph *glyph = &font->glyphs[index];
+        if (glyph->rec.width > 0) {
+            push_draw_command(TEXTURE_ATLAS, glyph->rec,
+                              (v2){pos.x + glyph->offset_x,
+                                   pos.y + glyph->offset_y},
+                              tint);
+        }
+        pos.x += glyph->advance_x;
+    }
+}
+
+internal v2 get_pickup_screen_pos(i32 x, i32 y) {
+    return (v2){(x - 0.5f) * (f32)TILE_WIDTH + 1,
+                (y - 0.5f) * (f32)TILE_HEIGHT + 1};
+}
+
+// Brings the dot layer up to date with game.dot_changes. Must be called
+// outside begin_frame()/end_frame(), raylib can't nest texture modes.
+internal void sync_dot_layer(Rectangle *sprite_tiles, u32 *tile_map) {
+    DotChanges *changes = &game.dot_changes;
+    if (!changes->refilled && changes->count == 0) {
+        return;
+    }
 
-            if (game.state == GAME_IN_PROGRESS) {
-                update(sprite_tiles, tile_map, dt);
-                if (pacman->state != PACMAN_DEAD) {
-                    update_animation_frame(&pill_anim);
+    Rectangle dot_image = sprite_tiles[3 * SPRITE_TILES_X];
+    b32 software = renderer.backend == RENDER_SOFTWARE;
+    if (!software) {
+        BeginTextureMode(renderer.dot_layer);
+    }
+
+    if (changes->refilled) {
+        renderer.pill_tile_count = 0;
+        if (software) {
+            soft_clear(&renderer.soft_dot_layer, BLANK);
+        } else {
+            ClearBackground(BLANK);
+        }
+        for (i32 y = 0; y < SCREEN_TILES_Y; y++) {
+            for (i32 x = 0; x < SCREEN_TILES_X; x++) {
+                u32 tile_type = tile_map[y * SCREEN_TILES_X + x];
+                if (tile_type == TILE_PILL &&
+                    renderer.pill_tile_count < PILL_COUNT) {
+                    renderer.pill_tiles[renderer.pill_tile_count++] =
+                        (v2i){x, y};
                 }
-                if (game.tick > game.ghost_recover.tick) {
-                    if (IsMusicStreamPlaying(game.power_pellet_bgm)) {
-                        StopMusicStream(game.power_pellet_bgm);
-                        PlayMusicStream(game.siren_bgm);
-                    }
+                if (tile_type != TILE_DOT) {
+                    continue;
                 }
-                if (game.pill_chomp.tick <= game.tick && game.tick <= game.ghost_recover.tick) {
-                    UpdateMusicStream(game.power_pellet_bgm);
+                v2 pos = get_pickup_screen_pos(x, y);
+                if (software) {
+                    soft_draw_image(&renderer.soft_dot_layer,
+                                    &renderer.images[TEXTURE_ATLAS],
+                                    dot_image, pos, WHITE);
                 } else {
-                    UpdateMusicStream(game.siren_bgm);
+                    DrawTextureRec(renderer.textures[TEXTURE_ATLAS],
+                                   dot_image, pos, WHITE);
                 }
-            } else if (game.state == GAME_LEVEL_COMPLETE) {
-                update_animation_frame(&maze_anim);
             }
-
-            if (game.score > game.high_score) {
-                game.high_score = game.score;
+        }
+    } else {
+        // A dot's pixels sit in the middle of its tile, so clearing the
+        // tile can't touch a neighbour.
+        for (u32 i = 0; i < changes->count; i++) {
+            v2i tile = changes->tiles[i];
+            if (software) {
+                soft_clear_rect(&renderer.soft_dot_layer, tile.x * TILE_WIDTH,
+                                tile.y * TILE_HEIGHT, TILE_WIDTH,
+                                TILE_HEIGHT, BLANK);
+            } else {
+                BeginScissorMode(tile.x * TILE_WIDTH, tile.y * TILE_HEIGHT,
+                                 TILE_WIDTH, TILE_HEIGHT);
+                ClearBackground(BLANK);
+                EndScissorMode();
             }
         }
+    }
 
-        BeginTextureMode(back_buffer);
-        {
-            ClearBackground(BLACK);
+    if (!software) {
+        EndTextureMode();
+    }
+    *changes = (DotChanges){0};
+    renderer.compositor.dot_version++;
+}
 
-            DrawTextEx(font, "HIGH SCORE", (v2){10 * TILE_WIDTH, TILE_HEIGHT},
-                       8, 0, Fade(WHITE, alpha));
+// Draws the rows [y, y + height) of a back buffer sized layer in place.
+internal void draw_layer_rows(u8 source, i32 y, i32 height, Color tint) {
+    Rectangle rec = {0, (f32)y, BACK_BUFFER_WIDTH, (f32)height};
+    if (renderer.backend != RENDER_SOFTWARE) {
+        // Render textures are stored upside down.
+        rec.y = (f32)(BACK_BUFFER_HEIGHT - y - height);
+        rec.height = -rec.height;
+    }
+    push_draw_command(source, rec, (v2){0, (f32)y}, tint);
+}
 
-            char score_text[10];
-            if (game.score < 10) {
-                sprintf_s(score_text, sizeof(score_text), "0%d", game.score);
-            } else {
-                sprintf_s(score_text, sizeof(score_text), "%d", game.score);
-            }
-            DrawTextEx(font, score_text, (v2){6 * TILE_WIDTH, 2 * TILE_HEIGHT},
-                       8, 0, Fade(WHITE, alpha));
-
-            if (game.high_score) {
-                char high_score_text[10];
-                if (game.high_score < 10) {
-                    sprintf_s(high_score_text, sizeof(high_score_text), "0%d",
-                              game.high_score);
-                } else {
-                    sprintf_s(high_score_text, sizeof(high_score_text), "%d",
-                              game.high_score);
-                }
-                DrawTextEx(font, high_score_text,
-                           (v2){15 * TILE_WIDTH, 2 * TILE_HEIGHT}, 8, 0, Fade(WHITE, alpha));
-            }
+internal void draw_dots(u32 *tile_map, Color tint) {
+    draw_layer_rows(BATCH_DOTS, 0, BACK_BUFFER_HEIGHT, tint);
 
-            // ====================== DRAW INTRO SCREEN ======================
+    for (u32 i = 0; i < renderer.pill_tile_count; i++) {
+        v2i tile = renderer.pill_tiles[i];
+        if (tile_map[tile.y * SCREEN_TILES_X + tile.x] == TILE_PILL) {
+            draw_texture_rec(TEXTURE_ATLAS,
+                             game.pill_anim.frames[game.pill_anim.frame_index],
+                             get_pickup_screen_pos(tile.x, tile.y), tint);
+        }
+    }
+}
 
-            if (game.state == GAME_INTRO || game.state == GAME_LOAD) {
-                DrawTextEx(font, "1UP", (v2){4 * TILE_WIDTH, TILE_HEIGHT},
-                        8, 0, Fade(WHITE, alpha));
+// Scores show at least two digits, like the arcade's "00".
+internal void format_score(char *text, u32 value) {
+    char digits[10];
+    u32 count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    if (count < 2) {
+        digits[count++] = '0';
+    }
+    for (u32 i = 0; i < count; i++) {
+        text[i] = digits[count - 1 - i];
+    }
+    text[count] = 0;
+}
 
-                DrawTextEx(font, "2UP", (v2){23 * TILE_WIDTH, TILE_HEIGHT},
-                        8, 0, Fade(WHITE, alpha));
+// Redraws the HUD layer if anything on it changed. Like sync_dot_layer(), it
+// must be called outside begin_frame()/end_frame().
+internal void sync_hud_layer(Rectangle *sprite_tiles) {
+    HudState state = {0};
+    state.valid = 1;
+    state.main_screen =
+        game.state != GAME_INTRO && game.state != GAME_LOAD;
+    state.score = game.score;
+    state.high_score = game.high_score;
+    if (state.main_screen) {
+        state.rounds_left = game.rounds_left;
+        state.fruit_count = game.level->bonus.type + 1;
+    }
+    if (memcmp(&state, &renderer.hud_state, sizeof(state)) == 0) {
+        return;
+    }
+    renderer.hud_state = state;
+    renderer.compositor.hud_version++;
 
-                DrawTextEx(font, "CHARACTER / NICKNAME", (v2){8 * TILE_WIDTH, 6 * TILE_HEIGHT},
-                        8, 0, Fade(WHITE, alpha));
-                // BLINKY
-                if (game.tick > 60) {
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (4 * SPRITE_TILES_X)),
-                                   (v2){5 * TILE_WIDTH, 8 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                }
-                if (game.tick > 120) {
-                    DrawTextEx(font, "-SHADOW",
-                            (v2){8 * TILE_WIDTH, 8.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){255, 0, 0, 255}, alpha));
-                }
-                if (game.tick > 150) {
-                    DrawTextEx(font, "BLINKY",
-                            (v2){18 * TILE_WIDTH, 8.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){255, 0, 0, 255}, alpha));
-                }
+    if (renderer.backend == RENDER_SOFTWARE) {
+        renderer.target = &renderer.soft_hud_layer;
+        soft_clear(renderer.target, BLANK);
+    } else {
+        BeginTextureMode(renderer.hud_layer);
+        ClearBackground(BLANK);
+    }
 
-                // PINKY
-                if (game.tick > 210) {
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (5 * SPRITE_TILES_X)),
-                                   (v2){5 * TILE_WIDTH, 11 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                }
-                if (game.tick > 270) {
-                    DrawTextEx(font, "-SPEEDY",
-                            (v2){8 * TILE_WIDTH, 11.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){252, 181, 255, 255}, alpha));
-                }
-                if (game.tick > 300) {
-                    DrawTextEx(font, "PINKY",
-                            (v2){18 * TILE_WIDTH, 11.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){252, 181, 255, 255}, alpha));
-                }
+    char text[12];
+    draw_text("HIGH SCORE", (v2){10 * TILE_WIDTH, TILE_HEIGHT}, 8, WHITE);
+    format_score(text, state.score);
+    draw_text(text, (v2){6 * TILE_WIDTH, 2 * TILE_HEIGHT}, 8, WHITE);
+    if (state.high_score) {
+        format_score(text, state.high_score);
+        draw_text(text, (v2){15 * TILE_WIDTH, 2 * TILE_HEIGHT}, 8, WHITE);
+    }
 
-                // INKY
-                if (game.tick > 360) {
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (6 * SPRITE_TILES_X)),
-                                   (v2){5 * TILE_WIDTH, 14 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                }
-                if (game.tick > 420) {
-                    DrawTextEx(font, "-BASHFUL",
-                            (v2){8 * TILE_WIDTH, 14.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){0, 255, 255, 255}, alpha));
-                }
-                if (game.tick > 450) {
-                    DrawTextEx(font, "INKY",
-                            (v2){18 * TILE_WIDTH, 14.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){0, 255, 255, 255}, alpha));
-                }
+    Rectangle *life_indicator = sprite_tiles + (2 * SPRITE_TILES_X + 13);
+    for (i32 i = 0; i < state.rounds_left; i++) {
+        draw_texture_rec(TEXTURE_ATLAS, *life_indicator,
+                         (v2){(f32)(i * 2 + 3) * TILE_WIDTH, HUD_BOTTOM_Y},
+                         WHITE);
+    }
+    for (u32 i = 0; i < state.fruit_count; i++) {
+        draw_texture_rec(TEXTURE_ATLAS,
+                         *(sprite_tiles + SPRITE_TILES_X + 13 + i),
+                         (v2){(f32)(25 - i * 2) * TILE_WIDTH, HUD_BOTTOM_Y},
+                         WHITE);
+    }
 
-                // CLYDE
-                if (game.tick > 510) {
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (7 * SPRITE_TILES_X)),
-                                   (v2){5 * TILE_WIDTH, 17 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                }
-                if (game.tick > 570) {
-                    DrawTextEx(font, "-POKEY",
-                            (v2){8 * TILE_WIDTH, 17.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){248, 187, 85, 255}, alpha));
-                }
-                if (game.tick > 600) {
-                    DrawTextEx(font, "CLYDE",
-                            (v2){18 * TILE_WIDTH, 17.5 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){248, 187, 85, 255}, alpha));
-                }
+    flush_batch();
+    if (renderer.backend == RENDER_SOFTWARE) {
+        renderer.target = &renderer.frame;
+    } else {
+        EndTextureMode();
+    }
+}
 
-                if (game.tick > 660) {
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (3 * SPRITE_TILES_X + 1)),
-                                   (v2){11 * TILE_WIDTH, 25 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                    DrawTextEx(font, "10",
-                            (v2){13.5 * TILE_WIDTH, 25.5 * TILE_HEIGHT}, 8, 0,
-                            WHITE);
-                    DrawTextEx(font, "PTS",
-                            (v2){16.5 * TILE_WIDTH, 25.5 * TILE_HEIGHT + 2}, 6, 0,
-                            WHITE);
-                    DrawTextureRec(sprite_tex,
-                                   *(sprite_tiles + (3 * SPRITE_TILES_X + 2)),
-                                   (v2){11 * TILE_WIDTH, 27 * TILE_HEIGHT}, Fade(WHITE, alpha));
-                    DrawTextEx(font, "50",
-                            (v2){13.5 * TILE_WIDTH, 27.5 * TILE_HEIGHT}, 8, 0,
-                            WHITE);
-                    DrawTextEx(font, "PTS",
-                            (v2){16.5 * TILE_WIDTH, 27.5 * TILE_HEIGHT + 2}, 6, 0,
-                            WHITE);
-                }
+internal void draw_hud(Color tint) {
+    draw_layer_rows(BATCH_HUD, 0, HUD_TOP_HEIGHT, tint);
+    draw_layer_rows(BATCH_HUD, HUD_BOTTOM_Y, BACK_BUFFER_HEIGHT - HUD_BOTTOM_Y,
+                    tint);
+}
 
-                if (game.tick > 720) {
-                    update_animation_frame(&press_any_key_anim);
-                    if (press_any_key_anim.frame_index == 0) {
-                        DrawTextEx(font, "PRESS ANY KEY TO START!",
-                                   (v2){4 * TILE_WIDTH, 32 * TILE_HEIGHT}, 8, 0,
-                                   Fade((Color){252, 181, 255, 255}, alpha));
-                    }
-                }
+// The paused tick and the keys, over the bottom left of the window.
+internal void draw_time_travel_overlay(u32 screen_height) {
+    if (!time_travel.paused) {
+        return;
+    }
+    History *history = &time_travel.history;
+    u64 newest = get_history_end(history) - 1;
+    char line[96];
+    snprintf(line, sizeof(line), "PAUSED  -%.2f s  tick %llu of %u kept",
+             (f64)(newest - time_travel.cursor) / FPS,
+             time_travel.cursor - history->first_tick + 1, history->count);
+    i32 y = (i32)screen_height - 32;
+    DrawRectangle(4, y, 330, 28, Fade(BLACK, 0.75f));
+    DrawText(line, 8, y + 2, 10, YELLOW);
+    DrawText("F5 resume  LEFT/RIGHT scrub  SHIFT faster  , . step", 8, y + 15,
+             10, WHITE);
+}
 
-                DrawTextEx(font, "CREDIT  0", (v2){4 * TILE_WIDTH, 36 * TILE_HEIGHT},
-                        8, 0, Fade(WHITE, alpha));
-            } else {
-            // ====================== DRAW MAIN SCREEN =======================
-                if (game.state == GAME_LEVEL_COMPLETE) {
-                    DrawTextureRec(maze_tex,
-                                maze_anim.frames[maze_anim.frame_index],
-                                maze_start_corner, Fade(WHITE, alpha));
-                } else {
-                    DrawTextureRec(maze_tex, maze_anim.frames[0], maze_start_corner,
-                                Fade(WHITE, alpha));
-                }
+// Scales the back buffer to the window, leaving out the one tile border.
+// Returns 0 without touching the window when it already shows this frame.
+internal b32 present_frame(u32 screen_width, u32 screen_height) {
+    Compositor *compositor = &renderer.compositor;
+    if (compositor->unchanged_frames % IDLE_PRESENT_TICKS != 0 &&
+        !profiler.overlay_visible && !time_travel.paused) {
+        return 0;
+    }
 
-                for (i32 i = 0; i < game.rounds_left; i++) {
-                    DrawTextureRec(
-                        sprite_tex, *life_indicator,
-                        (v2){(f32)(i * 2 + 3) * TILE_WIDTH, 35 * TILE_HEIGHT},
-                        Fade(WHITE, alpha));
-                }
+    Texture2D texture = renderer.back_buffer.texture;
+    // Render textures are stored upside down.
+    f32 flip = -1.0f;
+    if (renderer.backend == RENDER_SOFTWARE) {
+        if (compositor->unchanged_frames == 0) {
+            UpdateTexture(renderer.frame_tex, renderer.frame.pixels);
+        }
+        texture = renderer.frame_tex;
+        flip = 1.0f;
+    }
 
-                for (i32 i = 0; i < (game.level.bonus.type + 1); i++) {
-                    DrawTextureRec(
-                        sprite_tex, *(sprite_tiles + SPRITE_TILES_X + 13 + i),
-                        (v2){(f32)(25 - i * 2) * TILE_WIDTH, 35 * TILE_HEIGHT},
-                        Fade(WHITE, alpha));
-                }
+    BeginDrawing();
+    {
+        DrawTexturePro(
+            texture,
+            (Rectangle){TILE_WIDTH, TILE_HEIGHT,
+                        (f32)(texture.width - 2 * TILE_WIDTH),
+                        flip * (f32)(texture.height - 2 * TILE_HEIGHT)},
+            (Rectangle){TILE_WIDTH * SCALE, TILE_HEIGHT * SCALE,
+                        (f32)(screen_width - 2 * TILE_WIDTH * SCALE),
+                        (f32)(screen_height - 2 * TILE_HEIGHT * SCALE)},
+            (v2){0, 0}, 0.0f, WHITE);
+        draw_profile_overlay();
+        draw_time_travel_overlay(screen_height);
+    }
+    EndDrawing();
+    return 1;
+}
 
-                if (game.state == GAME_PRELUDE) {
-                    DrawTextEx(font, "PLAYER ONE",
-                            (v2){10 * TILE_WIDTH, 15 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){0, 255, 255, 255}, alpha));
-                }
-                if (game.state == GAME_PRELUDE || game.state == GAME_READY) {
-                    DrawTextEx(font, "READY!",
-                            (v2){12 * TILE_WIDTH, 21 * TILE_HEIGHT}, 8, 0,
-                            Fade((Color){255, 255, 0, 255}, alpha));
-                }
-                if (game.state == GAME_OVER) {
-                    DrawTextEx(font, "GAME  OVER",
-                               (v2){10 * TILE_WIDTH, 21 * TILE_HEIGHT}, 8, 0,
-                               Fade((Color){255, 0, 0, 255}, alpha));
-                }
+// Stands in for EndDrawing() on ticks that present nothing: polls input and
+// sleeps out the rest of the tick instead of waiting on a buffer swap.
+internal void idle_tick(f64 tick_start) {
+    PollInputEvents();
+    sleep_seconds(tick_start + 1.0 / FPS - get_seconds());
+    renderer.idle_tick_count++;
+}
 
-                if (game.level.bonus.state == BONUS_ACTIVE) {
-                    DrawTextureRec(sprite_tex, game.level.bonus.bonus_tile,
-                                (v2){bonus_pos.x - 0.5f * SPRITE_TILE_WIDTH,
-                                        bonus_pos.y - 0.5f * SPRITE_TILE_HEIGHT},
-                                Fade(WHITE, alpha));
-                } else if (game.level.bonus.state == BONUS_POINTS) {
-                    DrawTextureRec(
-                        sprite_tex, game.level.bonus.points_tile,
-                        (v2){
-                            bonus_pos.x - 0.5f * game.level.bonus.points_tile.width,
-                            bonus_pos.y -
-                                0.5f * game.level.bonus.points_tile.height},
-                        Fade(WHITE, alpha));
-                }
+internal void init_game() {
+    game.tick = 0;
+    game.rounds_left = ROUND_COUNT;
+    game.score = 0;
+    game.level_count = 0;
+    game.intro_cursor = 0;
+    game.intro_blinking = 0;
+
+    cancel(&game.load);
+    cancel(&game.prelude);
+    cancel(&game.ready);
+    cancel(&game.play);
+    cancel(&game.pill_chomp);
+    cancel(&game.ghost_start_recovery);
+    cancel(&game.ghost_recover);
+    cancel(&game.freeze);
+    cancel(&game.resume);
+    cancel(&game.round_over);
+    cancel(&game.level_complete);
+    cancel(&game.unload);
+    cancel(&game.bonus_timeup);
+    cancel(&game.bonus_collected);
+    cancel(&game.bonus_point_hide);
+}
 
-                for (i32 y = 0; y < SCREEN_TILES_Y; y++) {
-                    for (i32 x = 0; x < SCREEN_TILES_X; x++) {
-                        if (tile_map[y * SCREEN_TILES_X + x] == 2) {
-                            DrawTextureRec(sprite_tex, *dot_image,
-                                        (v2){(x - 0.5f) * (f32)TILE_WIDTH + 1,
-                                                (y - 0.5f) * (f32)TILE_HEIGHT + 1},
-                                        Fade(WHITE, alpha));
-                        }
-                        if (tile_map[y * SCREEN_TILES_X + x] == 3) {
-                            DrawTextureRec(sprite_tex,
-                                        pill_anim.frames[pill_anim.frame_index],
-                                        (v2){(x - 0.5f) * (f32)TILE_WIDTH + 1,
-                                                (y - 0.5f) * (f32)TILE_HEIGHT + 1},
-                                        Fade(WHITE, alpha));
-                        }
-                    }
-                }
+internal u8 read_input() {
+    u8 input = 0;
+    if (IsKeyDown(KEY_UP)) {
+        input |= INPUT_UP;
+    }
+    if (IsKeyDown(KEY_LEFT)) {
+        input |= INPUT_LEFT;
+    }
+    if (IsKeyDown(KEY_DOWN)) {
+        input |= INPUT_DOWN;
+    }
+    if (IsKeyDown(KEY_RIGHT)) {
+        input |= INPUT_RIGHT;
+    }
+    // The profiler's keys aren't game input.
+    i32 key = GetKeyPressed();
+    while (key == PROFILE_OVERLAY_KEY || key == FRAME_STATS_KEY ||
+           key == HISTORY_PAUSE_KEY) {
+        key = GetKeyPressed();
+    }
+    if (key != 0) {
+        input |= INPUT_START;
+    }
+    return input;
+}
 
-                if (game.state != GAME_PRELUDE &&
-                    game.state != GAME_ROUND_OVER && game.state != GAME_OVER &&
-                    game.state != GAME_LEVEL_COMPLETE && game.state != GAME_UNLOAD) {
-                    DrawTextureRec(
-                        sprite_tex, pacman->anim.frames[pacman->anim.frame_index],
-                        (v2){pacman->actor.pos.x - pacman->actor.half_dim.x,
-                            pacman->actor.pos.y - pacman->actor.half_dim.y},
-                        Fade(WHITE, alpha));
-                    if (game.pacman.state != PACMAN_DEAD) {
-                        DrawTextureRec(
-                            sprite_tex,
-                            blinky->anim.frames[blinky->anim.frame_index],
-                            (v2){blinky->actor.pos.x - blinky->actor.half_dim.x,
-                                blinky->actor.pos.y - blinky->actor.half_dim.y},
-                            Fade(WHITE, alpha));
-                        DrawTextureRec(
-                            sprite_tex,
-                            pinky->anim.frames[pinky->anim.frame_index],
-                            (v2){pinky->actor.pos.x - pinky->actor.half_dim.x,
-                                pinky->actor.pos.y - pinky->actor.half_dim.y},
-                            Fade(WHITE, alpha));
-                        DrawTextureRec(
-                            sprite_tex,
-                            inky->anim.frames[inky->anim.frame_index],
-                            (v2){inky->actor.pos.x - inky->actor.half_dim.x,
-                                inky->actor.pos.y - inky->actor.half_dim.y},
-                            Fade(WHITE, alpha));
-                        DrawTextureRec(
-                            sprite_tex,
-                            clyde->anim.frames[clyde->anim.frame_index],
-                            (v2){clyde->actor.pos.x - clyde->actor.half_dim.x,
-                                clyde->actor.pos.y - clyde->actor.half_dim.y},
-                            Fade(WHITE, alpha));
-                    }
+internal void load_audio() {
+    audio.prelude_sfx = LoadSound("assets/prelude.wav");
+    audio.chomp_sfx = LoadSound("assets/chomp.wav");
+    audio.death_sfx = LoadSound("assets/death.wav");
+    audio.bonus_sfx = LoadSound("assets/bonus.wav");
+    audio.ghost_eat_sfx = LoadSound("assets/ghost_eat.wav");
+    audio.siren_bgm = LoadMusicStream("assets/siren.wav");
+    audio.power_pellet_bgm = LoadMusicStream("assets/power_pellet.wav");
+}
+
+// Puts the game on the intro screen as it is at startup. Everything after
+// this is a function of the seed and the per-tick inputs.
+internal void start_session(u32 seed, Rectangle *sprite_tiles,
+                            Rectangle *maze_tiles) {
+    game = (Game){0};
+    game.tick = 0;
+    game.state = GAME_INTRO;
+    game.level = &levels[0];
+    game.bonus_state = BONUS_INACTIVE;
+    game.xorshift = seed;
+    game.alpha = 0.0f;
+    game.dot_changes.refilled = 1;
+    init_game();
+
+    load_pacman();
+    for (i32 i = 0; i < GHOST_TYPE_COUNT; i++) {
+        load_ghost(i);
+    }
+
+    game.pill_anim = (Animation){0};
+    game.pill_anim.frames = sprite_tiles + (3 * SPRITE_TILES_X + 2);
+    game.pill_anim.frame_count = 2;
+    game.pill_anim.ticks_per_anim_frame = PILL_TICKS_PER_ANIM_FRAME;
+
+    game.maze_anim = (Animation){0};
+    game.maze_anim.frames = maze_tiles;
+    game.maze_anim.frame_count = 2;
+    game.maze_anim.ticks_per_anim_frame = MAZE_TICKS_PER_ANIM_FRAME;
+
+    game.press_any_key_anim = (Animation){0};
+    game.press_any_key_anim.frame_count = 2;
+    game.press_any_key_anim.ticks_per_anim_frame =
+        PRESS_ANY_KEY_TICKS_PER_ANIM_FRAME;
+}
+
+// Starts the session over on another seed, keeping what outlives a session.
+internal void restart_session(u32 seed, Rectangle *sprite_tiles) {
+    Game saved = game;
+    StopMusicStream(audio.siren_bgm);
+    StopMusicStream(audio.power_pellet_bgm);
+    start_session(seed, sprite_tiles, atlas_maze_tiles);
+    game.high_score = saved.demo_active ? saved.demo_high_score
+                                        : saved.high_score;
+}
+
+// Once the intro reaches the timeline's loop tick it starts over, or plays
+// the timeline's demo replay from the start of its session. Any key ends the
+// demo. Returns the input the tick is simulated with.
+internal u8 update_attract_loop(u8 input, Rectangle *sprite_tiles) {
+    IntroTimeline *timeline = &intro_timeline;
+    if (game.demo_active) {
+        if ((input & INPUT_START) ||
+            game.demo_tick >= timeline->demo.tick_count) {
+            restart_session(game.xorshift, sprite_tiles);
+            return 0;
+        }
+        return timeline->demo.inputs[game.demo_tick++];
+    }
+
+    if (game.state == GAME_INTRO && timeline->loop_tick &&
+        game.tick == timeline->loop_tick) {
+        if (timeline->demo.tick_count) {
+            u32 high_score = game.high_score;
+            restart_session(timeline->demo.seed, sprite_tiles);
+            game.demo_active = 1;
+            game.demo_high_score = high_score;
+            game.demo_tick = 1;
+            return timeline->demo.inputs[0];
+        }
+        restart_session(game.xorshift, sprite_tiles);
+    }
+    return input;
+}
+
+// A replay only plays back under the intro it was recorded with, see
+// IntroTimeline.hash.
+internal b32 has_replay_intro(Replay *replay) {
+    return replay->intro_hash == intro_timeline.hash;
+}
+
+internal void advance_intro_cursor() {
+    IntroTimeline *timeline = &intro_timeline;
+    while (game.intro_cursor < timeline->count &&
+           timeline->keys[game.intro_cursor].tick <= game.tick) {
+        if (timeline->keys[game.intro_cursor].flags & INTRO_BLINK) {
+            game.intro_blinking = 1;
+        }
+        game.intro_cursor++;
+    }
+}
+
+// Advances everything but game.tick, which is bumped after the frame is
+// drawn.
+internal void simulate_tick(u8 input, Rectangle *sprite_tiles, u32 *tile_map) {
+    game.input = update_attract_loop(input, sprite_tiles);
+
+    if (game.state == GAME_INTRO) {
+        if (game.input & INPUT_START) {
+            game.state = GAME_LOAD;
+            after(&game.load, 30);
+            init_tile_map(tile_map);
+            game.eaten_tiles_hash = 0;
+            game.dot_changes.refilled = 1;
+        }
+
+        if (game.tick <= 30) {
+            game.alpha += 0.033333f;
+        } else {
+            game.alpha = 1.0f;
+        }
+    } else if (game.state == GAME_LOAD) {
+        if (!has_reached(&game.load)) {
+            game.alpha -= 0.033333f;
+        } else if (is_now(&game.load)) {
+            game.alpha = 0.0f;
+            game.tick = 0;
+            game.state = GAME_PRELUDE;
+            after(&game.ready, 2 * FPS);
+            PlaySound(audio.prelude_sfx);
+        }
+    } else if (game.state == GAME_UNLOAD) {
+        game.alpha -= 0.033333f;
+        if (has_reached(&game.unload) && since(&game.unload) >= 30) {
+            game.state = GAME_INTRO;
+            init_game();
+        }
+    } else if (game.state == GAME_PRELUDE && game.tick <= 30) {
+        if (game.tick < 30) {
+            game.alpha += 0.033333f;
+        } else if (game.tick == 30) {
+            game.alpha = 1.0f;
+        }
+    } else {
+        PROFILE_BEGIN(PROFILE_EVENTS);
+        if (is_now(&game.unload)) {
+            game.state = GAME_UNLOAD;
+        } else if (is_now(&game.freeze)) {
+            game.state = GAME_FROZEN;
+        } else if (is_now(&game.pill_chomp)) {
+            game.ghost_eaten_count = 0;
+            StopMusicStream(audio.siren_bgm);
+            PlayMusicStream(audio.power_pellet_bgm);
+        } else if (is_now(&game.play) || is_now(&game.resume)) {
+            DEBUG_LOG("START / RESUME!");
+            game.state = GAME_IN_PROGRESS;
+            PlayMusicStream(audio.siren_bgm);
+        } else if (is_now(&game.ready)) {
+            if (game.state == GAME_LEVEL_COMPLETE ||
+                    game.state == GAME_PRELUDE) {
+                game.level_count += 1;
+                init_level(game.level_count, tile_map);
+                init_round(sprite_tiles);
+            }
+            if (game.state == GAME_ROUND_OVER ||
+                game.state == GAME_PRELUDE) {
+                game.rounds_left -= 1;
+            }
+            if (game.state == GAME_ROUND_OVER) {
+                init_round(sprite_tiles);
+            }
+            game.state = GAME_READY;
+            after(&game.play, 3 * FPS);
+        } else if (is_now(&game.round_over)) {
+            game.state = GAME_ROUND_OVER;
+            after(&game.ready, 2 * FPS);
+        } else if (is_now(&game.level_complete)) {
+            game.state = GAME_LEVEL_COMPLETE;
+            after(&game.ready, 16 * MAZE_TICKS_PER_ANIM_FRAME);
+        } else if (game.pills_left == 0 && game.dots_left == 0 &&
+                game.state == GAME_IN_PROGRESS) {
+            game.state = GAME_FROZEN;
+            after(&game.level_complete, 1 * FPS);
+        }
+
+        u32 total_dots_eatens =
+            (DOT_COUNT + PILL_COUNT) - (game.dots_left + game.pills_left);
+
+        if (total_dots_eatens == 70 || total_dots_eatens == 170) {
+            game.bonus_state = BONUS_ACTIVE;
+            after(&game.bonus_timeup, 10 * FPS);
+        }
+
+        if (is_now(&game.bonus_collected)) {
+            cancel(&game.bonus_timeup);
+            game.bonus_state = BONUS_POINTS;
+        }
+
+        if (is_now(&game.bonus_timeup) || is_now(&game.bonus_point_hide)) {
+            game.bonus_state = BONUS_INACTIVE;
+        }
+
+        if (game.rounds_left < 0 && game.state != GAME_OVER &&
+            game.state != GAME_UNLOAD) {
+            game.state = GAME_OVER;
+            after(&game.unload, 2 * FPS);
+        }
+
+        PROFILE_END(PROFILE_EVENTS);
+
+        if (game.state == GAME_IN_PROGRESS) {
+            update(sprite_tiles, tile_map);
+            if (game.pacman.state != PACMAN_DEAD) {
+                update_animation_frame(&game.pill_anim);
+            }
+            if (has_passed(&game.ghost_recover)) {
+                if (IsMusicStreamPlaying(audio.power_pellet_bgm)) {
+                    StopMusicStream(audio.power_pellet_bgm);
+                    PlayMusicStream(audio.siren_bgm);
                 }
             }
+            PROFILE_BEGIN(PROFILE_MUSIC);
+            if (has_reached(&game.pill_chomp) &&
+                !has_passed(&game.ghost_recover)) {
+                UpdateMusicStream(audio.power_pellet_bgm);
+            } else {
+                UpdateMusicStream(audio.siren_bgm);
+            }
+            PROFILE_END(PROFILE_MUSIC);
+        } else if (game.state == GAME_LEVEL_COMPLETE) {
+            update_animation_frame(&game.maze_anim);
         }
-        EndTextureMode();
 
-        BeginDrawing();
-        {
-            DrawTexturePro(
-                back_buffer.texture,
-                (Rectangle){
-                    TILE_WIDTH, TILE_HEIGHT,
-                    (f32)(back_buffer.texture.width - 2 * TILE_WIDTH),
-                    (f32)(-back_buffer.texture.height + 2 * TILE_HEIGHT)},
-                (Rectangle){TILE_WIDTH * SCALE, TILE_HEIGHT * SCALE,
-                            (f32)(screen_width - 2 * TILE_WIDTH * SCALE),
-                            (f32)(screen_height - 2 * TILE_HEIGHT * SCALE)},
-                (v2){0, 0}, 0.0f, WHITE);
-        }
-        EndDrawing();
-        game.tick++;
+        if (game.score > game.high_score) {
+            game.high_score = game.score;
+        }
+    }
+
+    if (game.state == GAME_INTRO || game.state == GAME_LOAD) {
+        advance_intro_cursor();
+        if (game.intro_blinking) {
+            update_animation_frame(&game.press_any_key_anim);
+        }
+    }
+}
+
+internal void draw_intro(Rectangle *sprite_tiles) {
+    for (u32 i = 0; i < game.intro_cursor; i++) {
+        IntroKey *key = &intro_timeline.keys[i];
+        if ((key->flags & INTRO_BLINK) &&
+            game.press_any_key_anim.frame_index != 0) {
+            continue;
+        }
+        Color tint = key->color;
+        if (key->flags & INTRO_FADE) {
+            tint = Fade(tint, game.alpha);
+        }
+        if (key->kind == INTRO_TEXT) {
+            draw_text(key->text, key->pos, key->value, tint);
+        } else if (key->value < ATLAS_SPRITE_TILE_COUNT) {
+            draw_texture_rec(TEXTURE_ATLAS, sprite_tiles[key->value],
+                             key->pos, tint);
+        }
+    }
+}
+
+internal void draw_frame(Rectangle *sprite_tiles, u32 *tile_map) {
+    PacMan *pacman = &game.pacman;
+    Ghost *blinky = &game.ghosts[GHOST_BLINKY];
+    Ghost *pinky = &game.ghosts[GHOST_PINKY];
+    Ghost *inky = &game.ghosts[GHOST_INKY];
+    Ghost *clyde = &game.ghosts[GHOST_CLYDE];
+    v2 maze_start_corner = {TILE_WIDTH, SCORE_TILE_ROW_COUNT * TILE_HEIGHT};
+
+    PROFILE_BEGIN(PROFILE_DOTS);
+    sync_dot_layer(sprite_tiles, tile_map);
+    PROFILE_END(PROFILE_DOTS);
+    PROFILE_BEGIN(PROFILE_HUD);
+    sync_hud_layer(sprite_tiles);
+    PROFILE_END(PROFILE_HUD);
+    PROFILE_BEGIN(PROFILE_DRAW);
+    begin_frame();
+    {
+        draw_hud(Fade(WHITE, game.alpha));
+
+        // ====================== DRAW INTRO SCREEN ======================
+
+        if (game.state == GAME_INTRO || game.state == GAME_LOAD) {
+            draw_intro(sprite_tiles);
+        } else {
+        // ====================== DRAW MAIN SCREEN =======================
+            set_draw_layer(LAYER_MAZE);
+            if (game.state == GAME_LEVEL_COMPLETE) {
+                draw_texture_rec(TEXTURE_ATLAS,
+                            game.maze_anim.frames[game.maze_anim.frame_index],
+                            maze_start_corner, Fade(WHITE, game.alpha));
+            } else {
+                draw_texture_rec(TEXTURE_ATLAS, game.maze_anim.frames[0], maze_start_corner,
+                            Fade(WHITE, game.alpha));
+            }
+            set_draw_layer(LAYER_HUD);
+
+            if (game.state == GAME_PRELUDE) {
+                draw_text("PLAYER ONE",
+                        (v2){10 * TILE_WIDTH, 15 * TILE_HEIGHT}, 8,
+                        Fade((Color){0, 255, 255, 255}, game.alpha));
+            }
+            if (game.state == GAME_PRELUDE || game.state == GAME_READY) {
+                draw_text("READY!",
+                        (v2){12 * TILE_WIDTH, 21 * TILE_HEIGHT}, 8,
+                        Fade((Color){255, 255, 0, 255}, game.alpha));
+            }
+            if (game.state == GAME_OVER) {
+                draw_text("GAME  OVER",
+                          (v2){10 * TILE_WIDTH, 21 * TILE_HEIGHT}, 8,
+                          Fade((Color){255, 0, 0, 255}, game.alpha));
+            }
+
+            v2 bonus_screen_pos = get_screen_pos(bonus_pos);
+            if (game.bonus_state == BONUS_ACTIVE) {
+                draw_texture_rec(TEXTURE_ATLAS, game.level->bonus.bonus_tile,
+                            (v2){bonus_screen_pos.x - 0.5f * SPRITE_TILE_WIDTH,
+                                    bonus_screen_pos.y - 0.5f * SPRITE_TILE_HEIGHT},
+                            Fade(WHITE, game.alpha));
+            } else if (game.bonus_state == BONUS_POINTS) {
+                draw_texture_rec(
+                    TEXTURE_ATLAS, game.level->bonus.points_tile,
+                    (v2){
+                        bonus_screen_pos.x - 0.5f * game.level->bonus.points_tile.width,
+                        bonus_screen_pos.y -
+                            0.5f * game.level->bonus.points_tile.height},
+                    Fade(WHITE, game.alpha));
+            }
+
+            draw_dots(tile_map, Fade(WHITE, game.alpha));
+
+            if (game.state != GAME_PRELUDE &&
+                game.state != GAME_ROUND_OVER && game.state != GAME_OVER &&
+                game.state != GAME_LEVEL_COMPLETE && game.state != GAME_UNLOAD) {
+                set_draw_layer(LAYER_ACTORS);
+                draw_texture_rec(
+                    TEXTURE_ATLAS, pacman->anim.frames[pacman->anim.frame_index],
+                    (v2){get_screen_pos(pacman->actor.pos).x - pacman->actor.half_dim.x,
+                        get_screen_pos(pacman->actor.pos).y - pacman->actor.half_dim.y},
+                    Fade(WHITE, game.alpha));
+                if (game.pacman.state != PACMAN_DEAD) {
+                    draw_texture_rec(
+                        TEXTURE_ATLAS,
+                        blinky->anim.frames[blinky->anim.frame_index],
+                        (v2){get_screen_pos(blinky->actor.pos).x - blinky->actor.half_dim.x,
+                            get_screen_pos(blinky->actor.pos).y - blinky->actor.half_dim.y},
+                        Fade(WHITE, game.alpha));
+                    draw_texture_rec(
+                        TEXTURE_ATLAS,
+                        pinky->anim.frames[pinky->anim.frame_index],
+                        (v2){get_screen_pos(pinky->actor.pos).x - pinky->actor.half_dim.x,
+                            get_screen_pos(pinky->actor.pos).y - pinky->actor.half_dim.y},
+                        Fade(WHITE, game.alpha));
+                    draw_texture_rec(
+                        TEXTURE_ATLAS,
+                        inky->anim.frames[inky->anim.frame_index],
+                        (v2){get_screen_pos(inky->actor.pos).x - inky->actor.half_dim.x,
+                            get_screen_pos(inky->actor.pos).y - inky->actor.half_dim.y},
+                        Fade(WHITE, game.alpha));
+                    draw_texture_rec(
+                        TEXTURE_ATLAS,
+                        clyde->anim.frames[clyde->anim.frame_index],
+                        (v2){get_screen_pos(clyde->actor.pos).x - clyde->actor.half_dim.x,
+                            get_screen_pos(clyde->actor.pos).y - clyde->actor.half_dim.y},
+                        Fade(WHITE, game.alpha));
+
+                    u32 swarm_frame =
+                        (game.tick / GHOST_TICKS_PER_ANIM_FRAME) % 2;
+                    b32 swarm_panic = has_reached(&game.pill_chomp) &&
+                                      !has_reached(&game.ghost_recover);
+                    for (u32 i = 0; i < swarm.count; i++) {
+                        u32 tile_index =
+                            swarm_panic
+                                ? 4 * SPRITE_TILES_X + 8 + swarm_frame
+                                : (4 + swarm.type[i]) * SPRITE_TILES_X +
+                                      swarm_dir_sprite_offsets[swarm.dir[i]] +
+                                      swarm_frame;
+                        draw_texture_rec(
+                            TEXTURE_ATLAS, sprite_tiles[tile_index],
+                            (v2){(f32)swarm.pos_x[i] / SUBPIXELS -
+                                     0.5f * SPRITE_TILE_WIDTH,
+                                 (f32)swarm.pos_y[i] / SUBPIXELS -
+                                     0.5f * SPRITE_TILE_HEIGHT},
+                            Fade(WHITE, game.alpha));
+                    }
+                }
+            }
+        }
+    }
+    PROFILE_END(PROFILE_DRAW);
+    PROFILE_BEGIN(PROFILE_COMPOSE);
+    end_frame();
+    PROFILE_END(PROFILE_COMPOSE);
+}
+
+// ==================== STATE HASH ==================== //
+
+// Words of game state hash_game_state() packs, with room to spare.
+#define STATE_HASH_WORD_CAPACITY 64
+
+typedef struct {
+    u64 words[STATE_HASH_WORD_CAPACITY];
+    u32 count;
+} StateHasher;
+
+internal void hash_word(StateHasher *hasher, u64 word) {
+    hasher->words[hasher->count++] = word;
+}
+
+internal void hash_event(StateHasher *hasher, Event *ev) {
+    hash_word(hasher, ev->tick << 1 | (ev->scheduled ? 1 : 0));
+}
+
+internal void hash_animation(StateHasher *hasher, Animation *anim) {
+    hash_word(hasher, (u64)anim->frame_counter |
+                          (u64)anim->frame_index << 16 |
+                          (u64)anim->ticks_per_anim_frame << 32 |
+                          (u64)anim->frame_count << 48);
+}
+
+internal void hash_actor(StateHasher *hasher, Actor *actor) {
+    // The speed as where it sits in `levels`, which doesn't move between
+    // runs the way its address does.
+    u64 speed = actor->speed ? (u64)((u8 *)actor->speed - (u8 *)levels) + 1
+                             : 0;
+    hash_word(hasher, (u64)(u32)actor->pos.x | (u64)(u32)actor->pos.y << 32);
+    hash_word(hasher, speed | (u64)actor->dir << 32 |
+                          (u64)(actor->can_turn ? 1 : 0) << 40);
+}
+
+// Everything a tick reads and writes, packed field by field so that padding
+// and where things were loaded don't count: actors, ghost states, events, the
+// RNG, score and the eaten dots and pills. dot_changes is left out, it only
+// says what the renderer hasn't drawn yet.
+internal u64 hash_game_state(Game *state) {
+    StateHasher hasher;
+    hasher.count = 0;
+
+    u32 alpha;
+    memcpy(&alpha, &state->alpha, sizeof(alpha));
+    hash_word(&hasher, state->tick);
+    hash_word(&hasher, (u64)state->state | (u64)state->bonus_state << 8 |
+                           (u64)state->input << 16 |
+                           (u64)(state->level - levels) << 32);
+    hash_word(&hasher, (u64)state->xorshift | (u64)alpha << 32);
+    hash_word(&hasher, (u64)state->score | (u64)state->high_score << 32);
+    hash_word(&hasher, (u64)(u32)state->rounds_left |
+                           (u64)state->level_count << 32);
+    hash_word(&hasher, (u64)state->dots_left | (u64)state->pills_left << 32);
+    hash_word(&hasher, state->eaten_tiles_hash);
+    hash_word(&hasher, (u64)state->ghost_eaten_count |
+                           (u64)state->intro_cursor << 32);
+    hash_word(&hasher, (u64)(state->intro_blinking ? 1 : 0) |
+                           (u64)(state->demo_active ? 1 : 0) << 1 |
+                           (u64)state->demo_tick << 32);
+    hash_word(&hasher, state->demo_high_score);
+
+    PacMan *pacman = &state->pacman;
+    hash_actor(&hasher, &pacman->actor);
+    hash_animation(&hasher, &pacman->anim);
+    hash_word(&hasher, (u64)pacman->state | (u64)pacman->anim_type << 8 |
+                           (u64)(u16)pacman->tile.x << 16 |
+                           (u64)(u16)pacman->tile.y << 32);
+    for (u32 i = 0; i < GHOST_TYPE_COUNT; i++) {
+        Ghost *ghost = &state->ghosts[i];
+        hash_actor(&hasher, &ghost->actor);
+        hash_animation(&hasher, &ghost->anim);
+        hash_word(&hasher, (u64)ghost->state | (u64)ghost->anim_type << 8);
+        hash_event(&hasher, &ghost->eaten);
+        hash_event(&hasher, &ghost->turned_to_eyes);
+    }
+    hash_animation(&hasher, &state->pill_anim);
+    hash_animation(&hasher, &state->maze_anim);
+    hash_animation(&hasher, &state->press_any_key_anim);
+
+    Event *events[] = {
+        &state->load,           &state->prelude,
+        &state->ready,          &state->play,
+        &state->pill_chomp,     &state->ghost_start_recovery,
+        &state->ghost_recover,  &state->freeze,
+        &state->resume,         &state->round_over,
+        &state->level_complete, &state->unload,
+        &state->bonus_timeup,   &state->bonus_collected,
+        &state->bonus_point_hide,
+    };
+    for (u32 i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        hash_event(&hasher, events[i]);
+    }
+
+    return hash64(hasher.words, hasher.count * sizeof(u64), 0);
+}
+
+// ==================== KEYFRAMES ==================== //
+
+// Bump when Game changes meaning without changing size; keyframes written in
+// another format are skipped and tools simulate from the nearest one they
+// can read, or from the start.
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_FORMAT ((SNAPSHOT_VERSION << 24) | (u32)sizeof(Snapshot))
+
+// What a replay keyframe holds: the game with its pointers turned into
+// offsets, and the tile map as what differs from a fresh maze, which is
+// mostly zeros.
+typedef struct {
+    Game game;
+    u32 tile_map[SCREEN_TILES_X * SCREEN_TILES_Y];
+} Snapshot;
+
+// Offsets are from the table the pointer points into, plus one so null
+// stays null.
+internal void *to_offset(void *ptr, void *base) {
+    return ptr ? (void *)((u8 *)ptr - (u8 *)base + 1) : 0;
+}
+
+internal void *from_offset(void *offset, void *base) {
+    return offset ? (u8 *)base + ((u64)offset - 1) : 0;
+}
+
+// Between pointers and offsets, both ways.
+internal void swizzle_game(Game *state, b32 to_offsets) {
+    void *(*convert)(void *, void *) = to_offsets ? to_offset : from_offset;
+    Animation *sprite_anims[] = {
+        &state->pacman.anim,       &state->ghosts[0].anim,
+        &state->ghosts[1].anim,    &state->ghosts[2].anim,
+        &state->ghosts[3].anim,    &state->pill_anim,
+        &state->press_any_key_anim,
+    };
+    for (u32 i = 0; i < sizeof(sprite_anims) / sizeof(sprite_anims[0]); i++) {
+        sprite_anims[i]->frames =
+            convert(sprite_anims[i]->frames, atlas_sprite_tiles);
+    }
+    state->maze_anim.frames = convert(state->maze_anim.frames, atlas_maze_tiles);
+    state->level = convert(state->level, levels);
+    state->pacman.actor.speed = convert(state->pacman.actor.speed, levels);
+    for (u32 i = 0; i < GHOST_TYPE_COUNT; i++) {
+        state->ghosts[i].actor.speed =
+            convert(state->ghosts[i].actor.speed, levels);
+    }
+}
+
+internal void take_snapshot(Snapshot *snapshot, u32 *tile_map) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    memcpy(&snapshot->game, &game, sizeof(game));
+    swizzle_game(&snapshot->game, 1);
+    init_tile_map(snapshot->tile_map);
+    for (u32 i = 0; i < SCREEN_TILES_X * SCREEN_TILES_Y; i++) {
+        snapshot->tile_map[i] ^= tile_map[i];
+    }
+}
+
+internal void restore_snapshot(Snapshot *snapshot, Game *state,
+                               u32 *tile_map) {
+    *state = snapshot->game;
+    swizzle_game(state, 0);
+    init_tile_map(tile_map);
+    for (u32 i = 0; i < SCREEN_TILES_X * SCREEN_TILES_Y; i++) {
+        tile_map[i] ^= snapshot->tile_map[i];
+    }
+}
+
+// Unpacks a keyframe into `state` and `tile_map`, returns 0 if it's damaged.
+internal b32 read_keyframe(ReplayKeyframe *keyframe, Game *state,
+                           u32 *tile_map) {
+    Snapshot snapshot;
+    if (keyframe->size != sizeof(snapshot) ||
+        !unpack_zero_runs(keyframe->packed, keyframe->packed_size,
+                          (u8 *)&snapshot, sizeof(snapshot))) {
+        return 0;
+    }
+    restore_snapshot(&snapshot, state, tile_map);
+    return 1;
+}
+
+// Whether a keyframe holds the state the game and `tile_map` are in now.
+internal b32 check_keyframe(ReplayKeyframe *keyframe, u32 *tile_map) {
+    Game state;
+    u32 keyframe_tile_map[SCREEN_TILES_X * SCREEN_TILES_Y];
+    return read_keyframe(keyframe, &state, keyframe_tile_map) &&
+           hash_game_state(&state) == hash_game_state(&game) &&
+           memcmp(keyframe_tile_map, tile_map, sizeof(keyframe_tile_map)) == 0;
+}
+
+// Writes the keyframe for the state before the next tick when one is due.
+internal void record_keyframe(ReplayWriter *recorder, u32 *tile_map) {
+    if (is_replay_keyframe_due(recorder)) {
+        Snapshot snapshot;
+        take_snapshot(&snapshot, tile_map);
+        write_replay_keyframe(recorder, &snapshot, sizeof(snapshot));
+    }
+}
+
+// Puts the game at the start of tick `tick` of the replay: from the last
+// keyframe before it, simulating the ticks in between. Returns how many were
+// simulated, which is the whole way from tick zero without keyframes.
+internal u32 seek_replay(Replay *replay, u32 tick, Rectangle *sprite_tiles,
+                         Rectangle *maze_tiles, u32 *tile_map) {
+    start_session(replay->seed, sprite_tiles, maze_tiles);
+    u32 from = 0;
+    ReplayKeyframe *keyframe =
+        find_replay_keyframe(replay, tick, SNAPSHOT_FORMAT);
+    if (keyframe && read_keyframe(keyframe, &game, tile_map)) {
+        from = keyframe->tick;
+        game.dot_changes = (DotChanges){0};
+        game.dot_changes.refilled = 1;
+        renderer.compositor.valid = 0;
+    } else if (keyframe) {
+        TraceLog(LOG_WARNING, "REPLAY: Keyframe at tick %u is damaged",
+                 keyframe->tick);
+    }
+    for (u32 i = from; i < tick && i < replay->tick_count; i++) {
+        simulate_tick(replay->inputs[i], sprite_tiles, tile_map);
+        game.tick++;
+    }
+    return tick - from;
+}
+
+// ==================== TIME TRAVEL ==================== //
+
+// F5 pauses the game on its newest tick. While paused the arrow keys scrub
+// back and forth through the kept history, and F5 again plays on from the
+// tick shown, forgetting the ticks that came after it.
+
+// Keeps the state before the next tick.
+internal void record_time_travel(u32 *tile_map) {
+    if (time_travel.history.bytes) {
+        Snapshot snapshot;
+        take_snapshot(&snapshot, tile_map);
+        record_history(&time_travel.history, &snapshot);
+    }
+}
+
+internal void show_history_tick(u64 tick, u32 *tile_map) {
+    Snapshot snapshot;
+    if (!read_history(&time_travel.history, tick, &snapshot)) {
+        TraceLog(LOG_WARNING, "HISTORY: Tick %llu is damaged", tick);
+        return;
+    }
+    restore_snapshot(&snapshot, &game, tile_map);
+    game.dot_changes = (DotChanges){0};
+    game.dot_changes.refilled = 1;
+    renderer.compositor.valid = 0;
+    time_travel.cursor = tick;
+}
+
+// Starts over whichever track the game would be playing at this point.
+internal void sync_music() {
+    StopMusicStream(audio.siren_bgm);
+    StopMusicStream(audio.power_pellet_bgm);
+    if (game.state != GAME_IN_PROGRESS) {
+        return;
+    }
+    if (has_reached(&game.pill_chomp) && !has_passed(&game.ghost_recover)) {
+        PlayMusicStream(audio.power_pellet_bgm);
+    } else {
+        PlayMusicStream(audio.siren_bgm);
+    }
+}
+
+// Handles the pause and scrub keys. Returns whether the game is paused. A
+// recording can't follow the game back in time, so playing on from an
+// earlier tick stops it.
+internal b32 update_time_travel(u32 *tile_map, ReplayWriter *recorder) {
+    History *history = &time_travel.history;
+    if (!history->count) {
+        return 0;
+    }
+    u64 newest = get_history_end(history) - 1;
+    if (IsKeyPressed(HISTORY_PAUSE_KEY)) {
+        if (!time_travel.paused) {
+            time_travel.paused = 1;
+            time_travel.cursor = newest;
+            PauseMusicStream(audio.siren_bgm);
+            PauseMusicStream(audio.power_pellet_bgm);
+            return 1;
+        }
+        time_travel.paused = 0;
+        if (time_travel.cursor < newest) {
+            truncate_history(history, time_travel.cursor);
+            TraceLog(LOG_INFO, "HISTORY: Playing on from %.2f s back",
+                     (f64)(newest - time_travel.cursor) / FPS);
+            if (recorder->file) {
+                TraceLog(LOG_WARNING,
+                         "REPLAY: Stopped recording, the game went back");
+                close_replay_writer(recorder);
+            }
+        }
+        sync_music();
+        return 0;
+    }
+    if (!time_travel.paused) {
+        return 0;
+    }
+
+    i64 step = 0;
+    i64 scrub = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)
+                    ? HISTORY_FAST_SCRUB_TICKS
+                    : 1;
+    if (IsKeyDown(KEY_LEFT)) {
+        step -= scrub;
+    }
+    if (IsKeyDown(KEY_RIGHT)) {
+        step += scrub;
+    }
+    if (IsKeyPressed(KEY_COMMA)) {
+        step -= 1;
+    }
+    if (IsKeyPressed(KEY_PERIOD)) {
+        step += 1;
+    }
+    i64 target = (i64)time_travel.cursor + step;
+    if (target < (i64)history->first_tick) {
+        target = (i64)history->first_tick;
+    } else if (target > (i64)newest) {
+        target = (i64)newest;
+    }
+    if ((u64)target != time_travel.cursor) {
+        show_history_tick((u64)target, tile_map);
+    }
+    return 1;
+}
+
+// ==================== VIDEO EXPORT ==================== //
+
+// Back buffer without the one tile border, as the window shows it.
+internal void copy_visible_frame(u32 *dst) {
+    for (i32 y = 0; y < EXPORT_HEIGHT; y++) {
+        memcpy(dst + y * EXPORT_WIDTH,
+               renderer.frame.pixels + (y + TILE_HEIGHT) * BACK_BUFFER_WIDTH +
+                   TILE_WIDTH,
+               EXPORT_WIDTH * sizeof(u32));
+    }
+}
+
+typedef enum { EXPORT_Y4M, EXPORT_PNG } ExportFormat;
+
+typedef enum {
+    EXPORT_SLOT_FREE,
+    EXPORT_SLOT_RENDERED,
+    EXPORT_SLOT_ENCODED
+} ExportSlotState;
+
+typedef struct {
+    ExportSlotState state;
+    u32 frame;
+    u32 *pixels;
+    u8 *encoded;
+} ExportSlot;
+
+// Frames are rendered on the main thread into a ring of slots, encoded by
+// the workers in any order and written out by the main thread in frame
+// order as their slots come around again.
+typedef struct {
+    ExportFormat format;
+    const char *output;
+    ExportSlot *slots;
+    u32 slot_count;
+    u32 rendered_count;
+    u32 encode_next;
+    b32 done;
+    Mutex mutex;
+    CondVar changed;
+} Exporter;
+
+internal void encode_export_frame(Exporter *exporter, ExportSlot *slot) {
+    if (exporter->format == EXPORT_PNG) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%06u.png", exporter->output,
+                 slot->frame);
+        Image image = {slot->pixels, EXPORT_WIDTH, EXPORT_HEIGHT, 1,
+                       PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+        ExportImage(image, path);
+        return;
+    }
+
+    // Planar 4:4:4 BT.601 studio range, which is what Y4M readers assume.
+    u32 plane_size = EXPORT_WIDTH * EXPORT_HEIGHT;
+    u8 *y_plane = slot->encoded;
+    u8 *u_plane = y_plane + plane_size;
+    u8 *v_plane = u_plane + plane_size;
+    for (u32 i = 0; i < plane_size; i++) {
+        i32 r = slot->pixels[i] & 0xFF;
+        i32 g = (slot->pixels[i] >> 8) & 0xFF;
+        i32 b = (slot->pixels[i] >> 16) & 0xFF;
+        y_plane[i] = (u8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u_plane[i] = (u8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v_plane[i] = (u8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
+
+internal void export_worker(void *data) {
+    Exporter *exporter = (Exporter *)data;
+    for (;;) {
+        lock_mutex(&exporter->mutex);
+        while (exporter->encode_next == exporter->rendered_count &&
+               !exporter->done) {
+            wait_cond(&exporter->changed, &exporter->mutex);
+        }
+        if (exporter->encode_next == exporter->rendered_count) {
+            unlock_mutex(&exporter->mutex);
+            break;
+        }
+        ExportSlot *slot =
+            &exporter->slots[exporter->encode_next % exporter->slot_count];
+        exporter->encode_next++;
+        unlock_mutex(&exporter->mutex);
+
+        encode_export_frame(exporter, slot);
+
+        lock_mutex(&exporter->mutex);
+        slot->state = EXPORT_SLOT_ENCODED;
+        broadcast_cond(&exporter->changed);
+        unlock_mutex(&exporter->mutex);
+    }
+}
+
+// Waits for the frame in the slot to be encoded and writes it out.
+internal void retire_export_slot(Exporter *exporter, ExportSlot *slot,
+                                 FILE *file) {
+    lock_mutex(&exporter->mutex);
+    while (slot->state == EXPORT_SLOT_RENDERED) {
+        wait_cond(&exporter->changed, &exporter->mutex);
+    }
+    unlock_mutex(&exporter->mutex);
+
+    if (slot->state == EXPORT_SLOT_ENCODED && file) {
+        fputs("FRAME\n", file);
+        fwrite(slot->encoded, 1, EXPORT_WIDTH * EXPORT_HEIGHT * 3, file);
+    }
+    slot->state = EXPORT_SLOT_FREE;
+}
+
+// Plays a replay back without a window and writes every frame from
+// `first_tick` on, cropped like the window, to a Y4M file, to stdout ("-")
+// or as PNGs into a directory.
+internal i32 export_replay(const char *replay_path, const char *output,
+                           u32 first_tick, u32 job_count, u32 swarm_count) {
+    Exporter exporter = {0};
+    exporter.output = output;
+    exporter.format = EXPORT_PNG;
+    if (strcmp(output, "-") == 0 || IsFileExtension(output, ".y4m")) {
+        exporter.format = EXPORT_Y4M;
+    }
+
+    if (strcmp(output, "-") == 0) {
+        log_to_stderr = 1;
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+
+    Replay replay;
+    if (!load_replay(replay_path, &replay, &permanent_arena)) {
+        TraceLog(LOG_ERROR, "EXPORT: [%s] Failed to load replay", replay_path);
+        return 1;
+    }
+    if (!has_replay_intro(&replay)) {
+        TraceLog(LOG_ERROR, "EXPORT: [%s] Recorded with another --intro",
+                 replay_path);
+        return 1;
+    }
+
+    FILE *file = 0;
+    if (exporter.format == EXPORT_Y4M) {
+        file = strcmp(output, "-") == 0 ? stdout : fopen(output, "wb");
+        if (!file) {
+            TraceLog(LOG_ERROR, "EXPORT: [%s] Failed to open output", output);
+            return 1;
+        }
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", EXPORT_WIDTH,
+                EXPORT_HEIGHT, FPS);
+    } else if (!DirectoryExists(output)) {
+        TraceLog(LOG_ERROR, "EXPORT: [%s] Output directory does not exist",
+                 output);
+        return 1;
+    }
+
+    if (!job_count) {
+        // The main thread is busy simulating and rendering.
+        job_count = get_cpu_count() > 1 ? get_cpu_count() - 1 : 1;
+    }
+    exporter.slot_count = 2 * job_count;
+    exporter.slots =
+        push_array(&permanent_arena, ExportSlot, exporter.slot_count);
+    for (u32 i = 0; i < exporter.slot_count; i++) {
+        exporter.slots[i].pixels = push_array(&permanent_arena, u32,
+                                              EXPORT_WIDTH * EXPORT_HEIGHT);
+        exporter.slots[i].encoded = push_array(
+            &permanent_arena, u8, EXPORT_WIDTH * EXPORT_HEIGHT * 3);
+    }
+    init_mutex(&exporter.mutex);
+    init_cond(&exporter.changed);
+
+    Thread *workers = push_array(&permanent_arena, Thread, job_count);
+    for (u32 i = 0; i < job_count; i++) {
+        workers[i] = start_thread(export_worker, &exporter);
+    }
+
+    load_renderer(RENDER_SOFTWARE, 1);
+    u32 *tile_map = get_tile_map();
+    Rectangle *sprite_tiles = atlas_sprite_tiles;
+    Rectangle *maze_tiles = atlas_maze_tiles;
+    if (first_tick > replay.tick_count) {
+        first_tick = replay.tick_count;
+    }
+    f64 start = get_seconds();
+    u32 seek_ticks =
+        seek_replay(&replay, first_tick, sprite_tiles, maze_tiles, tile_map);
+    if (first_tick) {
+        TraceLog(LOG_INFO, "EXPORT: Starting at tick %u, %u ticks simulated to get there",
+                 first_tick, seek_ticks);
+    }
+    if (swarm_count) {
+        init_swarm(swarm_count);
+    }
+
+    b32 diverged = 0;
+    u32 frame_count = replay.tick_count - first_tick;
+    for (u32 frame = first_tick; frame < replay.tick_count; frame++) {
+        u32 index = frame - first_tick;
+        ExportSlot *slot = &exporter.slots[index % exporter.slot_count];
+        retire_export_slot(&exporter, slot, file);
+
+        simulate_tick(replay.inputs[frame], sprite_tiles, tile_map);
+        u64 expected_state;
+        if (!diverged && get_replay_hash(&replay, frame, &expected_state) &&
+            hash_game_state(&game) != expected_state) {
+            char ticks[64];
+            TraceLog(LOG_WARNING,
+                     "EXPORT: [%s] State differs from the recording after "
+                     "%s, the video won't match it from there",
+                     replay_path,
+                     format_replay_ticks(ticks, sizeof(ticks),
+                                         get_replay_hash_window(&replay, frame),
+                                         frame));
+            diverged = 1;
+        }
+        draw_frame(sprite_tiles, tile_map);
+        game.tick++;
+
+        copy_visible_frame(slot->pixels);
+        slot->frame = frame;
+
+        lock_mutex(&exporter.mutex);
+        slot->state = EXPORT_SLOT_RENDERED;
+        exporter.rendered_count = index + 1;
+        broadcast_cond(&exporter.changed);
+        unlock_mutex(&exporter.mutex);
+    }
+
+    // Flush the frames still in flight, oldest first.
+    for (u32 i = 0; i < exporter.slot_count; i++) {
+        retire_export_slot(
+            &exporter,
+            &exporter.slots[(frame_count + i) % exporter.slot_count],
+            file);
+    }
+
+    lock_mutex(&exporter.mutex);
+    exporter.done = 1;
+    broadcast_cond(&exporter.changed);
+    unlock_mutex(&exporter.mutex);
+    for (u32 i = 0; i < job_count; i++) {
+        join_thread(workers[i]);
+    }
+
+    if (file && file != stdout) {
+        fclose(file);
+    } else if (file) {
+        fflush(file);
+    }
+
+    f64 elapsed = get_seconds() - start;
+    TraceLog(LOG_INFO, "EXPORT: %u frames in %.2f s, %.1fx real time, %u jobs",
+             frame_count, elapsed, frame_count / (elapsed * FPS), job_count);
+    return 0;
+}
+
+// ==================== GOLDEN FRAMES ==================== //
+
+// Every replay in a directory is played back through the software renderer
+// and each back buffer is hashed. <name>.golden next to <name>.rep holds the
+// expected hashes, one per line, and --golden-update rewrites them. The state
+// hashes recorded in the replay are checked along the way, and rewritten on
+// update too.
+
+// Writes the frame that broke the golden list, and if a known-good frame
+// (e.g. from --export on an older build) sits next to it, a diff image with
+// the changed pixels in red over the dimmed actual frame.
+internal void dump_golden_mismatch(const char *dir, const char *name,
+                                   u32 frame) {
+    TempMemory temp = begin_temp_memory(&permanent_arena);
+    SoftImage actual =
+        push_soft_image(&permanent_arena, EXPORT_WIDTH, EXPORT_HEIGHT);
+    copy_visible_frame(actual.pixels);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s_%06u_actual.png", dir, name, frame);
+    ExportImage(soft_to_image(&actual), path);
+
+    snprintf(path, sizeof(path), "%s/%s_%06u_expected.png", dir, name, frame);
+    if (!FileExists(path)) {
+        TraceLog(LOG_INFO, "GOLDEN: Save the known-good frame as %s for a diff",
+                 path);
+        end_temp_memory(temp);
+        return;
+    }
+
+    Image expected = LoadImage(path);
+    ImageFormat(&expected, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (expected.width != EXPORT_WIDTH || expected.height != EXPORT_HEIGHT) {
+        TraceLog(LOG_WARNING, "GOLDEN: [%s] Expected a %dx%d frame", path,
+                 EXPORT_WIDTH, EXPORT_HEIGHT);
+    } else {
+        u32 *expected_pixels = (u32 *)expected.data;
+        u32 changed = 0;
+        for (i32 i = 0; i < EXPORT_WIDTH * EXPORT_HEIGHT; i++) {
+            if (actual.pixels[i] != expected_pixels[i]) {
+                actual.pixels[i] = soft_pack(RED);
+                changed++;
+            } else {
+                actual.pixels[i] = SOFT_ALPHA_MASK |
+                                   ((actual.pixels[i] >> 2) & 0x003F3F3F);
+            }
+        }
+        snprintf(path, sizeof(path), "%s/%s_%06u_diff.png", dir, name, frame);
+        ExportImage(soft_to_image(&actual), path);
+        TraceLog(LOG_INFO, "GOLDEN: %u pixels differ", changed);
+    }
+
+    UnloadImage(expected);
+    end_temp_memory(temp);
+}
+
+internal i32 run_golden(const char *dir, b32 update) {
+    load_renderer(RENDER_SOFTWARE, 1);
+    u32 *tile_map = get_tile_map();
+    Rectangle *sprite_tiles = atlas_sprite_tiles;
+    Rectangle *maze_tiles = atlas_maze_tiles;
+
+    FilePathList files = LoadDirectoryFilesEx(dir, ".rep", 0);
+    if (files.count == 0) {
+        TraceLog(LOG_ERROR, "GOLDEN: [%s] No replays to check", dir);
+        UnloadDirectoryFiles(files);
+        return 1;
+    }
+    u32 failures = 0;
+    u64 total_frames = 0;
+    f64 start = get_seconds();
+
+    for (u32 i = 0; i < files.count; i++) {
+        char name[256];
+        snprintf(name, sizeof(name), "%s",
+                 GetFileNameWithoutExt(files.paths[i]));
+        char golden_path[512];
+        snprintf(golden_path, sizeof(golden_path), "%s/%s.golden", dir, name);
+
+        // Everything for one replay goes when the next one starts.
+        TempMemory temp = begin_temp_memory(&permanent_arena);
+        Replay replay;
+        if (!load_replay(files.paths[i], &replay, &permanent_arena)) {
+            end_temp_memory(temp);
+            failures++;
+            continue;
+        }
+        if (!has_replay_intro(&replay)) {
+            TraceLog(LOG_ERROR, "GOLDEN: [%s] Recorded with another --intro",
+                     name);
+            end_temp_memory(temp);
+            failures++;
+            continue;
+        }
+
+        u64 *expected = 0;
+        u32 expected_count = 0;
+        if (!update) {
+            char *text = LoadFileText(golden_path);
+            if (!text) {
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] Missing %s", name,
+                         golden_path);
+                end_temp_memory(temp);
+                failures++;
+                continue;
+            }
+            expected =
+                push_array(&permanent_arena, u64, replay.tick_count + 1);
+            char *cursor = text;
+            while (expected_count <= replay.tick_count) {
+                char *next;
+                u64 hash = strtoull(cursor, &next, 16);
+                if (next == cursor) {
+                    break;
+                }
+                expected[expected_count++] = hash;
+                cursor = next;
+            }
+            UnloadFileText(text);
+        }
+
+        u64 *hashes = push_array(&permanent_arena, u64, replay.tick_count + 1);
+        // On update the replay is recorded again next to the old one, with
+        // fresh hashes and keyframes, and replaces it if everything passed.
+        char rerecord_path[512];
+        snprintf(rerecord_path, sizeof(rerecord_path), "%s.tmp",
+                 files.paths[i]);
+        ReplayWriter rerecorder = {0};
+        if (update) {
+            open_replay_writer(
+                &rerecorder, rerecord_path, replay.seed,
+                replay.hash_interval ? replay.hash_interval
+                                     : REPLAY_DEFAULT_HASH_INTERVAL,
+                replay.keyframe_interval ? replay.keyframe_interval
+                                         : REPLAY_DEFAULT_KEYFRAME_INTERVAL,
+                SNAPSHOT_FORMAT);
+            if (!rerecorder.file) {
+                end_temp_memory(temp);
+                failures++;
+                continue;
+            }
+            write_replay_intro(&rerecorder, replay.intro_hash);
+        }
+        start_session(replay.seed, sprite_tiles, maze_tiles);
+        b32 matched = 1;
+        u32 keyframe_index = 0;
+        for (u32 frame = 0; frame < replay.tick_count; frame++) {
+            // Seeking has to land where playing through does.
+            if (keyframe_index < replay.keyframe_count &&
+                replay.keyframes[keyframe_index].tick == frame) {
+                ReplayKeyframe *keyframe = &replay.keyframes[keyframe_index++];
+                if (!update && replay.keyframe_format == SNAPSHOT_FORMAT &&
+                    !check_keyframe(keyframe, tile_map)) {
+                    TraceLog(LOG_ERROR,
+                             "GOLDEN: [%s] Keyframe at tick %u differs", name,
+                             frame);
+                    matched = 0;
+                    break;
+                }
+            }
+            record_keyframe(&rerecorder, tile_map);
+            write_replay_input(&rerecorder, replay.inputs[frame]);
+
+            // A tick that allocates would grow a long-running cabinet's
+            // memory, so it fails the run like a wrong frame.
+            u64 allocations = allocation_count;
+            simulate_tick(replay.inputs[frame], sprite_tiles, tile_map);
+            u64 expected_state;
+            if (is_replay_hash_due(&rerecorder)) {
+                write_replay_hash(&rerecorder, hash_game_state(&game));
+            } else if (!update &&
+                       get_replay_hash(&replay, frame, &expected_state) &&
+                       hash_game_state(&game) != expected_state) {
+                char ticks[64];
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] State differs after %s", name,
+                         format_replay_ticks(
+                             ticks, sizeof(ticks),
+                             get_replay_hash_window(&replay, frame), frame));
+                matched = 0;
+                break;
+            }
+            draw_frame(sprite_tiles, tile_map);
+            game.tick++;
+            total_frames++;
+            if (allocation_count != allocations) {
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] Frame %u allocated", name,
+                         frame);
+                matched = 0;
+                break;
+            }
+
+            hashes[frame] = hash64(renderer.frame.pixels,
+                                   BACK_BUFFER_WIDTH * BACK_BUFFER_HEIGHT *
+                                       sizeof(u32),
+                                   0);
+            if (!update &&
+                (frame >= expected_count || hashes[frame] != expected[frame])) {
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] Frame %u differs", name,
+                         frame);
+                dump_golden_mismatch(dir, name, frame);
+                matched = 0;
+                break;
+            }
+        }
+        if (matched && !update && expected_count != replay.tick_count) {
+            TraceLog(LOG_ERROR, "GOLDEN: [%s] %u golden frames for %u ticks",
+                     name, expected_count, replay.tick_count);
+            matched = 0;
+        }
+
+        if (update && matched) {
+            FILE *file = fopen(golden_path, "w");
+            if (file) {
+                for (u32 frame = 0; frame < replay.tick_count; frame++) {
+                    fprintf(file, "%016llx\n", hashes[frame]);
+                }
+                fclose(file);
+                TraceLog(LOG_INFO, "GOLDEN: [%s] Wrote %u frames", name,
+                         replay.tick_count);
+            } else {
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] Failed to write %s", name,
+                         golden_path);
+                matched = 0;
+            }
+        } else if (matched) {
+            TraceLog(LOG_INFO, "GOLDEN: [%s] %u frames OK", name,
+                     replay.tick_count);
+        }
+        if (update) {
+            write_replay_score(&rerecorder, game.score, game.high_score);
+            close_replay_writer(&rerecorder);
+            // rename() doesn't replace an existing file everywhere.
+            if (!matched) {
+                remove(rerecord_path);
+            } else if (remove(files.paths[i]) != 0 ||
+                       rename(rerecord_path, files.paths[i]) != 0) {
+                TraceLog(LOG_ERROR, "GOLDEN: [%s] Failed to replace %s", name,
+                         files.paths[i]);
+                matched = 0;
+            }
+        }
+        if (!matched) {
+            failures++;
+        }
+
+        end_temp_memory(temp);
+    }
+
+    f64 elapsed = get_seconds() - start;
+    TraceLog(LOG_INFO, "GOLDEN: %u replays, %u failed, %.0f frames/s",
+             files.count, failures, total_frames / (elapsed > 0 ? elapsed : 1));
+    UnloadDirectoryFiles(files);
+    return failures ? 1 : 0;
+}
+
+// ==================== REPLAY VERIFICATION ==================== //
+
+// Every replay in a directory is simulated again without drawing and checked
+// against the state hashes, keyframes and final score it recorded. A pool of
+// threads takes the replays one at a time off a shared counter, each with its
+// own game state and arena, so a corpus of recorded sessions runs on every
+// core.
+
+typedef enum {
+    VERIFY_OK,
+    VERIFY_LOAD_FAILED,
+    VERIFY_INTRO_DIFFERS,
+    VERIFY_STATE_DIFFERS,
+    VERIFY_KEYFRAME_DIFFERS,
+    VERIFY_SCORE_DIFFERS,
+} VerifyStatus;
+
+typedef struct {
+    VerifyStatus status;
+    // Where it first differed; a state hash only narrows it down to the
+    // ticks from first_tick on.
+    u32 first_tick;
+    u32 tick;
+    u32 tick_count;
+    u32 score;
+    u32 high_score;
+    u32 expected_score;
+    u32 expected_high_score;
+} VerifyResult;
+
+typedef struct {
+    FilePathList files;
+    VerifyResult *results;
+    volatile u32 next_file;
+} Verifier;
+
+internal void verify_replay(Replay *replay, u32 *tile_map,
+                            VerifyResult *result) {
+    Rectangle *sprite_tiles = atlas_sprite_tiles;
+    start_session(replay->seed, sprite_tiles, atlas_maze_tiles);
+    b32 check_keyframes = replay->keyframe_format == SNAPSHOT_FORMAT;
+    u32 keyframe_index = 0;
+    // A keyframe holds the state before its tick, so the last one can come
+    // after the last input.
+    for (u32 tick = 0; tick <= replay->tick_count; tick++) {
+        if (keyframe_index < replay->keyframe_count &&
+            replay->keyframes[keyframe_index].tick == tick) {
+            ReplayKeyframe *keyframe = &replay->keyframes[keyframe_index++];
+            if (check_keyframes && !check_keyframe(keyframe, tile_map)) {
+                result->status = VERIFY_KEYFRAME_DIFFERS;
+                result->tick = tick;
+                return;
+            }
+        }
+        if (tick == replay->tick_count) {
+            break;
+        }
+
+        simulate_tick(replay->inputs[tick], sprite_tiles, tile_map);
+        u64 expected_state;
+        if (get_replay_hash(replay, tick, &expected_state) &&
+            hash_game_state(&game) != expected_state) {
+            result->status = VERIFY_STATE_DIFFERS;
+            result->first_tick = get_replay_hash_window(replay, tick);
+            result->tick = tick;
+            return;
+        }
+        game.tick++;
+        result->tick_count++;
+    }
+
+    result->score = game.score;
+    result->high_score = game.high_score;
+    result->expected_score = replay->final_score;
+    result->expected_high_score = replay->final_high_score;
+    if (replay->has_final_score &&
+        (game.score != replay->final_score ||
+         game.high_score != replay->final_high_score)) {
+        result->status = VERIFY_SCORE_DIFFERS;
+        result->tick = replay->tick_count;
+    }
+}
+
+internal void verify_worker(void *data) {
+    Verifier *verifier = (Verifier *)data;
+    Arena arena;
+    b32 ready = init_arena(&arena, "verify", VERIFY_ARENA_SIZE);
+    u32 *tile_map =
+        ready ? push_array(&arena, u32, SCREEN_TILES_X * SCREEN_TILES_Y) : 0;
+    for (;;) {
+        u32 index = atomic_add_u32(&verifier->next_file, 1);
+        if (index >= verifier->files.count) {
+            break;
+        }
+        VerifyResult *result = &verifier->results[index];
+        TempMemory temp = begin_temp_memory(&arena);
+        Replay replay;
+        if (!tile_map ||
+            !load_replay(verifier->files.paths[index], &replay, &arena)) {
+            result->status = VERIFY_LOAD_FAILED;
+        } else if (!has_replay_intro(&replay)) {
+            result->status = VERIFY_INTRO_DIFFERS;
+        } else {
+            verify_replay(&replay, tile_map, result);
+        }
+        end_temp_memory(temp);
+    }
+}
+
+internal i32 run_verify(const char *dir, u32 job_count) {
+    Verifier verifier = {0};
+    verifier.files = LoadDirectoryFilesEx(dir, ".rep", 0);
+    // A mistyped corpus path must not pass as a clean run.
+    if (verifier.files.count == 0) {
+        TraceLog(LOG_ERROR, "VERIFY: [%s] No replays to verify", dir);
+        UnloadDirectoryFiles(verifier.files);
+        return 1;
+    }
+    verifier.results =
+        push_array(&permanent_arena, VerifyResult, verifier.files.count + 1);
+    if (!job_count) {
+        job_count = get_cpu_count();
+    }
+    if (job_count > verifier.files.count) {
+        job_count = verifier.files.count;
+    }
+
+    // raylib logs every file it loads, which would bury the mismatches.
+    SetTraceLogLevel(LOG_WARNING);
+    f64 start = get_seconds();
+    Thread *workers = push_array(&permanent_arena, Thread, job_count);
+    for (u32 i = 0; i < job_count; i++) {
+        workers[i] = start_thread(verify_worker, &verifier);
+    }
+    for (u32 i = 0; i < job_count; i++) {
+        join_thread(workers[i]);
+    }
+    f64 elapsed = get_seconds() - start;
+    SetTraceLogLevel(LOG_MIN_LEVEL);
+
+    u32 failures = 0;
+    u64 total_ticks = 0;
+    for (u32 i = 0; i < verifier.files.count; i++) {
+        VerifyResult *result = &verifier.results[i];
+        const char *name = GetFileName(verifier.files.paths[i]);
+        total_ticks += result->tick_count;
+        if (result->status == VERIFY_OK) {
+            continue;
+        }
+        failures++;
+        if (result->status == VERIFY_LOAD_FAILED) {
+            TraceLog(LOG_ERROR, "VERIFY: [%s] Failed to load", name);
+        } else if (result->status == VERIFY_INTRO_DIFFERS) {
+            TraceLog(LOG_ERROR, "VERIFY: [%s] Recorded with another --intro",
+                     name);
+        } else if (result->status == VERIFY_STATE_DIFFERS) {
+            char ticks[64];
+            TraceLog(LOG_ERROR, "VERIFY: [%s] State differs after %s", name,
+                     format_replay_ticks(ticks, sizeof(ticks),
+                                         result->first_tick, result->tick));
+        } else if (result->status == VERIFY_KEYFRAME_DIFFERS) {
+            TraceLog(LOG_ERROR, "VERIFY: [%s] Keyframe at tick %u differs",
+                     name, result->tick);
+        } else {
+            TraceLog(LOG_ERROR,
+                     "VERIFY: [%s] Ended on %u points, high score %u; "
+                     "recorded %u, %u",
+                     name, result->score, result->high_score,
+                     result->expected_score, result->expected_high_score);
+        }
+    }
+
+    TraceLog(LOG_INFO,
+             "VERIFY: %u replays, %u failed, %llu ticks in %.2f s, %.0f "
+             "ticks/s on %u threads",
+             verifier.files.count, failures, total_ticks, elapsed,
+             total_ticks / (elapsed > 0 ? elapsed : 1), job_count);
+    UnloadDirectoryFiles(verifier.files);
+    return failures ? 1 : 0;
+}
+
+// ==================== FRAME TIMING ==================== //
+
+// What the game was doing when a frame ran over, and the profiler's phase
+// times for it and the frames before it.
+typedef struct {
+    u32 frame;
+    u64 duration;
+    u64 tick;
+    GameState state;
+    u32 level_count;
+    u32 score;
+    u64 zones[HITCH_HISTORY_FRAMES][PROFILE_ZONE_COUNT];
+} Hitch;
+
+typedef struct {
+    // Wall time from one frame's start to the next, vsync wait included.
+    Histogram frames;
+    // simulate_tick() alone.
+    Histogram ticks;
+    Hitch hitches[HITCH_CAPACITY];
+    u32 hitch_count;
+    u32 frame_count;
+} FrameStats;
+
+global FrameStats frame_stats = {0};
+
+internal void capture_hitch(u64 duration) {
+    u32 index = frame_stats.hitch_count++;
+    if (index >= HITCH_CAPACITY) {
+        return;
+    }
+    Hitch *hitch = &frame_stats.hitches[index];
+    hitch->frame = frame_stats.frame_count;
+    hitch->duration = duration;
+    // game.tick has already moved on to the next frame.
+    hitch->tick = game.tick - 1;
+    hitch->state = game.state;
+    hitch->level_count = game.level_count;
+    hitch->score = game.score;
+    for (u32 i = 0; i < HITCH_HISTORY_FRAMES && i < profiler.frame_count;
+         i++) {
+        u32 frame = (profiler.frame_count - 1 - i) % PROFILE_HISTORY_FRAMES;
+        memcpy(hitch->zones[i], profiler.history[frame],
+               sizeof(hitch->zones[i]));
+    }
+}
+
+internal void record_frame_time(u64 frame_ns, u64 tick_ns) {
+    record_histogram(&frame_stats.frames, frame_ns);
+    record_histogram(&frame_stats.ticks, tick_ns);
+    if (frame_ns > HITCH_THRESHOLD_NS) {
+        capture_hitch(frame_ns);
+    }
+    frame_stats.frame_count++;
+}
+
+internal void log_histogram(const char *name, Histogram *histogram) {
+    if (!histogram->count) {
+        return;
+    }
+    TraceLog(LOG_INFO,
+             "TIMING: %s p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, "
+             "max %.3f ms, mean %.3f ms over %llu",
+             name, get_histogram_percentile(histogram, 50.0) / 1e6,
+             get_histogram_percentile(histogram, 99.0) / 1e6,
+             get_histogram_percentile(histogram, 99.9) / 1e6,
+             histogram->max / 1e6,
+             (f64)histogram->total / (f64)histogram->count / 1e6,
+             histogram->count);
+}
+
+internal void log_frame_stats() {
+    log_histogram("frame", &frame_stats.frames);
+    log_histogram("tick", &frame_stats.ticks);
+    TraceLog(LOG_INFO, "TIMING: %u frames over %.2f ms", frame_stats.hitch_count,
+             HITCH_THRESHOLD_NS / 1e6);
+
+    u32 count = frame_stats.hitch_count < HITCH_CAPACITY
+                    ? frame_stats.hitch_count
+                    : HITCH_CAPACITY;
+    for (u32 i = 0; i < count; i++) {
+        Hitch *hitch = &frame_stats.hitches[i];
+        // The slowest phase of the hitching frame, leaving out the frame
+        // total itself.
+        u32 slowest = PROFILE_INPUT;
+        for (u32 zone = PROFILE_INPUT; zone < PROFILE_ZONE_COUNT; zone++) {
+            if (hitch->zones[0][zone] > hitch->zones[0][slowest]) {
+                slowest = zone;
+            }
+        }
+        TraceLog(LOG_INFO,
+                 "HITCH: frame %u took %.2f ms at tick %llu, state %d, level %u, "
+                 "score %u; slowest phase %s %.2f ms, previous frames "
+                 "%.2f %.2f %.2f ms",
+                 hitch->frame, hitch->duration / 1e6, hitch->tick,
+                 hitch->state, hitch->level_count, hitch->score,
+                 profile_zone_names[slowest],
+                 hitch->zones[0][slowest] / 1e6,
+                 hitch->zones[1][PROFILE_FRAME] / 1e6,
+                 hitch->zones[2][PROFILE_FRAME] / 1e6,
+                 hitch->zones[3][PROFILE_FRAME] / 1e6);
+    }
+}
+
+// ==================== BENCHMARKS ==================== //
+
+// --bench <file> times the simulation's hot paths and the software render
+// path without a window and writes one "name,ns_per_op,ops_per_second" line
+// per benchmark. Each one is run with doubling iteration counts until a run
+// takes BENCH_MIN_SECONDS, and the best of BENCH_REPEATS runs is kept. With
+// --bench-baseline <file>, results more than --bench-threshold percent slower
+// than the baseline's fail the run.
+
+typedef void (*BenchProc)(u32 iterations);
+
+typedef struct {
+    const char *name;
+    BenchProc proc;
+} Benchmark;
+
+typedef struct {
+    Game game;
+    u32 *tile_map;
+    u32 *tile_map_saved;
+    Rectangle *sprite_tiles;
+    u32 xorshift;
+    // Keeps results alive so the measured calls aren't optimized out.
+    volatile i32 sink;
+} BenchState;
+
+global BenchState bench = {0};
+
+// Scripted play: a new direction every half second, and START whenever the
+// game is back on the intro screen.
+internal u8 get_bench_input() {
+    if (game.state == GAME_INTRO) {
+        return game.tick % 64 == 10 ? INPUT_START : 0;
+    }
+    if (game.tick % 30 == 0) {
+        bench.xorshift ^= bench.xorshift << 13;
+        bench.xorshift ^= bench.xorshift >> 17;
+        bench.xorshift ^= bench.xorshift << 5;
+    }
+    return (u8)(1 << (bench.xorshift % DIR_COUNT));
+}
+
+internal void run_bench_tick(b32 draw) {
+    simulate_tick(get_bench_input(), bench.sprite_tiles, bench.tile_map);
+    if (draw) {
+        draw_frame(bench.sprite_tiles, bench.tile_map);
+    }
+    game.tick++;
+}
+
+internal void start_bench_session() {
+    bench.xorshift = DEFAULT_SEED;
+    start_session(DEFAULT_SEED, bench.sprite_tiles, atlas_maze_tiles);
+}
+
+// A level a couple of seconds into play, the starting point of the
+// per-function benchmarks.
+internal void save_bench_game() {
+    start_bench_session();
+    while (game.state != GAME_IN_PROGRESS) {
+        run_bench_tick(0);
+    }
+    for (u32 i = 0; i < 2 * FPS && game.state == GAME_IN_PROGRESS; i++) {
+        run_bench_tick(0);
+    }
+    bench.game = game;
+    memcpy(bench.tile_map_saved, bench.tile_map,
+           SCREEN_TILES_X * SCREEN_TILES_Y * sizeof(u32));
+}
+
+internal void restore_bench_game() {
+    game = bench.game;
+    memcpy(bench.tile_map, bench.tile_map_saved,
+           SCREEN_TILES_X * SCREEN_TILES_Y * sizeof(u32));
+}
+
+internal void bench_get_tile(u32 iterations) {
+    i32 sum = 0;
+    for (u32 i = 0; i < iterations; i++) {
+        v2i pos = {(i32)(i * 37 % SUBPX(BACK_BUFFER_WIDTH)),
+                   (i32)(i * 91 % SUBPX(BACK_BUFFER_HEIGHT))};
+        v2i tile = get_tile(pos);
+        sum += tile.x + tile.y;
+    }
+    bench.sink = sum;
+}
+
+internal void bench_can_move(u32 iterations) {
+    restore_bench_game();
+    i32 sum = 0;
+    for (u32 i = 0; i < iterations; i++) {
+        v2i tile = {1 + (i32)(i % (SCREEN_TILES_X - 2)),
+                    4 + (i32)(i / SCREEN_TILES_X % (SCREEN_TILES_Y - 8))};
+        v2i tile_pos = get_tile_pos(tile);
+        v2i dir_vec = dir_vectors[i % DIR_COUNT];
+        v2i next_pos = v2i_add(tile_pos, v2i_mul(dir_vec, (i32)(i % 16)));
+        sum += can_move(bench.tile_map, &next_pos, &tile, &tile_pos, &dir_vec,
+                        (i & 4) != 0);
+    }
+    bench.sink = sum;
+}
+
+// Ghosts wander off or change state quickly, so the saved game is put back
+// every BENCH_RESTORE_TICKS updates.
+#define BENCH_RESTORE_TICKS 64
+
+internal void bench_update_ghost(u32 iterations, GhostState state) {
+    for (u32 i = 0; i < iterations; i++) {
+        if (i % BENCH_RESTORE_TICKS == 0) {
+            restore_bench_game();
+        }
+        game.ghosts[GHOST_BLINKY].state = state;
+        TickContext context = prepare_tick();
+        update_ghost(GHOST_BLINKY, &context, bench.sprite_tiles,
+                     bench.tile_map);
+        game.tick++;
+    }
+}
+
+internal void bench_update_ghost_scatter(u32 iterations) {
+    bench_update_ghost(iterations, GHOST_SCATTER);
+}
+
+internal void bench_update_ghost_chase(u32 iterations) {
+    bench_update_ghost(iterations, GHOST_CHASE);
+}
+
+internal void bench_update_ghost_panic(u32 iterations) {
+    bench_update_ghost(iterations, GHOST_PANIC);
+}
+
+internal void bench_update_ghost_eyes(u32 iterations) {
+    bench_update_ghost(iterations, GHOST_EYES);
+}
+
+internal void bench_update_pacman(u32 iterations) {
+    for (u32 i = 0; i < iterations; i++) {
+        if (i % BENCH_RESTORE_TICKS == 0) {
+            restore_bench_game();
+        }
+        game.input = (u8)(1 << (i / 16 % DIR_COUNT));
+        update_pacman(bench.sprite_tiles, bench.tile_map);
+        game.tick++;
+    }
+}
+
+// simulate_tick() with nothing but the event ladder left to run.
+internal void bench_event_dispatch(u32 iterations) {
+    restore_bench_game();
+    game.state = GAME_FROZEN;
+    cancel(&game.ready);
+    cancel(&game.play);
+    cancel(&game.pill_chomp);
+    cancel(&game.freeze);
+    cancel(&game.resume);
+    cancel(&game.round_over);
+    cancel(&game.level_complete);
+    cancel(&game.unload);
+    cancel(&game.bonus_timeup);
+    cancel(&game.bonus_collected);
+    cancel(&game.bonus_point_hide);
+    for (u32 i = 0; i < iterations; i++) {
+        simulate_tick(0, bench.sprite_tiles, bench.tile_map);
+        game.tick++;
+    }
+}
+
+internal void bench_hash_game_state(u32 iterations) {
+    restore_bench_game();
+    u64 sum = 0;
+    for (u32 i = 0; i < iterations; i++) {
+        sum += hash_game_state(&game);
+        game.tick++;
+    }
+    bench.sink = (i32)sum;
+}
+
+// Full sessions of scripted play, simulation only.
+internal void bench_game_tick(u32 iterations) {
+    start_bench_session();
+    for (u32 i = 0; i < iterations; i++) {
+        run_bench_tick(0);
+    }
+}
+
+// The same with every tick kept in the time-travel history.
+internal void bench_game_tick_history(u32 iterations) {
+    start_bench_session();
+    for (u32 i = 0; i < iterations; i++) {
+        run_bench_tick(0);
+        record_time_travel(bench.tile_map);
+    }
+}
+
+// The same with every frame drawn, as the game runs.
+internal void bench_game_frame(u32 iterations) {
+    start_bench_session();
+    for (u32 i = 0; i < iterations; i++) {
+        run_bench_tick(1);
+    }
+}
+
+// Every dot and pill, all five actors and the bonus on screen, with the
+// whole back buffer redrawn each frame.
+internal void bench_render_worst_case(u32 iterations) {
+    restore_bench_game();
+    init_tile_map(bench.tile_map);
+    game.dot_changes.refilled = 1;
+    game.bonus_state = BONUS_ACTIVE;
+    for (u32 i = 0; i < iterations; i++) {
+        renderer.compositor.valid = 0;
+        draw_frame(bench.sprite_tiles, bench.tile_map);
+        game.tick++;
+    }
+}
+
+global Benchmark benchmarks[] = {
+    {"get_tile", bench_get_tile},
+    {"can_move", bench_can_move},
+    {"update_ghost_scatter", bench_update_ghost_scatter},
+    {"update_ghost_chase", bench_update_ghost_chase},
+    {"update_ghost_panic", bench_update_ghost_panic},
+    {"update_ghost_eyes", bench_update_ghost_eyes},
+    {"update_pacman", bench_update_pacman},
+    {"event_dispatch", bench_event_dispatch},
+    {"hash_game_state", bench_hash_game_state},
+    {"game_tick", bench_game_tick},
+    {"game_tick_history", bench_game_tick_history},
+    {"game_frame", bench_game_frame},
+    {"render_worst_case", bench_render_worst_case},
+};
+
+internal f64 measure_benchmark(Benchmark *benchmark) {
+    u32 iterations = 1;
+    f64 elapsed = 0;
+    for (;;) {
+        f64 start = get_seconds();
+        benchmark->proc(iterations);
+        elapsed = get_seconds() - start;
+        if (elapsed >= BENCH_MIN_SECONDS || iterations >= (1u << 30)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    f64 best = elapsed / iterations;
+    for (u32 i = 1; i < BENCH_REPEATS; i++) {
+        f64 start = get_seconds();
+        benchmark->proc(iterations);
+        f64 per_op = (get_seconds() - start) / iterations;
+        if (per_op < best) {
+            best = per_op;
+        }
+    }
+    return best * 1e9;
+}
+
+// Looks a benchmark up in a results file, returns 0 when it isn't there.
+internal f64 find_bench_result(const char *text, const char *name) {
+    u32 name_length = (u32)strlen(name);
+    for (const char *line = text; line && *line;) {
+        if (strncmp(line, name, name_length) == 0 &&
+            line[name_length] == ',') {
+            return strtod(line + name_length + 1, 0);
+        }
+        line = strchr(line, '\n');
+        if (line) {
+            line++;
+        }
+    }
+    return 0;
+}
+
+internal i32 run_benchmarks(const char *output, const char *baseline_path,
+                            f64 threshold) {
+    load_renderer(RENDER_SOFTWARE, 1);
+    bench.tile_map = get_tile_map();
+    bench.tile_map_saved = get_tile_map();
+    bench.sprite_tiles = atlas_sprite_tiles;
+    init_history(&time_travel.history, &permanent_arena,
+                 HISTORY_DEFAULT_MB * 1024ULL * 1024, sizeof(Snapshot),
+                 HISTORY_KEYFRAME_TICKS);
+    save_bench_game();
+
+    char *baseline = 0;
+    if (baseline_path) {
+        baseline = LoadFileText(baseline_path);
+        if (!baseline) {
+            TraceLog(LOG_ERROR, "BENCH: Missing baseline %s", baseline_path);
+            return 1;
+        }
+    }
+    FILE *file = fopen(output, "w");
+    if (!file) {
+        TraceLog(LOG_ERROR, "BENCH: Failed to open %s for writing", output);
+        UnloadFileText(baseline);
+        return 1;
+    }
+    fprintf(file, "name,ns_per_op,ops_per_second\n");
+
+    u32 regressions = 0;
+    u32 count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (u32 i = 0; i < count; i++) {
+        Benchmark *benchmark = &benchmarks[i];
+        f64 ns = measure_benchmark(benchmark);
+        fprintf(file, "%s,%.3f,%.0f\n", benchmark->name, ns, 1e9 / ns);
+
+        f64 base = baseline ? find_bench_result(baseline, benchmark->name) : 0;
+        if (base > 0) {
+            f64 change = (ns / base - 1.0) * 100.0;
+            if (change > threshold) {
+                regressions++;
+                TraceLog(LOG_WARNING,
+                         "BENCH: [%s] %.1f ns, %.1f%% slower than %.1f ns",
+                         benchmark->name, ns, change, base);
+            } else {
+                TraceLog(LOG_INFO, "BENCH: [%s] %.1f ns, %+.1f%%",
+                         benchmark->name, ns, change);
+            }
+        } else {
+            TraceLog(LOG_INFO, "BENCH: [%s] %.1f ns, %.0f per second",
+                     benchmark->name, ns, 1e9 / ns);
+        }
+    }
+    fclose(file);
+    UnloadFileText(baseline);
+
+    if (baseline) {
+        TraceLog(LOG_INFO, "BENCH: %u of %u slower than the baseline by %.0f%%",
+                 regressions, count, threshold);
+    }
+    return regressions ? 1 : 0;
+}
+
+i32 main(i32 argc, char **argv) {
+    SetTraceLogCallback(trace_log_callback);
+    SetTraceLogLevel(LOG_MIN_LEVEL);
+    start_logger();
+    if (!init_memory()) {
+        stop_logger();
+        return 1;
+    }
+    load_levels(atlas_sprite_tiles);
+
+    u32 swarm_count = 0;
+    RenderBackend backend = RENDER_GPU;
+    const char *record_path = 0;
+    u32 hash_interval = REPLAY_DEFAULT_HASH_INTERVAL;
+    u32 keyframe_interval = REPLAY_DEFAULT_KEYFRAME_INTERVAL;
+    u32 export_from = 0;
+    const char *export_path = 0;
+    const char *export_output = 0;
+    u32 job_count = 0;
+    const char *golden_dir = 0;
+    b32 golden_update = 0;
+    const char *verify_dir = 0;
+    u32 history_mb = HISTORY_DEFAULT_MB;
+    const char *intro_path = 0;
+    const char *profile_name = 0;
+    const char *bench_output = 0;
+    const char *bench_baseline = 0;
+    f64 bench_threshold = BENCH_THRESHOLD_PERCENT;
+    for (i32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--swarm") == 0 && i + 1 < argc) {
+            swarm_count = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--software") == 0) {
+            backend = RENDER_SOFTWARE;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--hash-interval") == 0 && i + 1 < argc) {
+            hash_interval = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--keyframe-interval") == 0 &&
+                   i + 1 < argc) {
+            keyframe_interval = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--export") == 0 && i + 2 < argc) {
+            export_path = argv[++i];
+            export_output = argv[++i];
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            export_from = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            job_count = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_dir = argv[++i];
+        } else if (strcmp(argv[i], "--golden-update") == 0 && i + 1 < argc) {
+            golden_dir = argv[++i];
+            golden_update = 1;
+        } else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+            verify_dir = argv[++i];
+        } else if (strcmp(argv[i], "--history-mb") == 0 && i + 1 < argc) {
+            history_mb = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--intro") == 0 && i + 1 < argc) {
+            intro_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_name = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_output = argv[++i];
+        } else if (strcmp(argv[i], "--bench-baseline") == 0 && i + 1 < argc) {
+            bench_baseline = argv[++i];
+        } else if (strcmp(argv[i], "--bench-threshold") == 0 &&
+                   i + 1 < argc) {
+            bench_threshold = atof(argv[++i]);
+        }
+    }
+
+    if (bench_output) {
+        i32 result = run_benchmarks(bench_output, bench_baseline,
+                                    bench_threshold);
+        stop_logger();
+        return result;
+    }
+    // Before the tools, which play replays back under the same intro.
+    if (intro_path &&
+        !load_intro_timeline(intro_path, &intro_timeline, &permanent_arena)) {
+        TraceLog(LOG_WARNING, "INTRO: Keeping the built-in timeline");
+    }
+
+    if (golden_dir) {
+        i32 result = run_golden(golden_dir, golden_update);
+        stop_logger();
+        return result;
+    }
+    if (verify_dir) {
+        i32 result = run_verify(verify_dir, job_count);
+        stop_logger();
+        return result;
+    }
+    if (export_path) {
+        i32 result = export_replay(export_path, export_output, export_from,
+                                   job_count, swarm_count);
+        stop_logger();
+        return result;
+    }
+
+    u32 screen_width = (u32)(BACK_BUFFER_WIDTH * SCALE);
+    u32 screen_height = (u32)(BACK_BUFFER_HEIGHT * SCALE);
+
+    InitWindow(screen_width, screen_height, "pacman0");
+    InitAudioDevice();
+    SetTargetFPS(FPS);
+
+    load_renderer(backend, 0);
+
+    u32 *tile_map = get_tile_map();
+    Rectangle *sprite_tiles = atlas_sprite_tiles;
+    Rectangle *maze_tiles = atlas_maze_tiles;
+
+    start_session(DEFAULT_SEED, sprite_tiles, maze_tiles);
+    load_audio();
+    if (swarm_count) {
+        init_swarm(swarm_count);
+    }
+    if (history_mb &&
+        !init_history(&time_travel.history, &permanent_arena,
+                      history_mb * 1024ULL * 1024, sizeof(Snapshot),
+                      HISTORY_KEYFRAME_TICKS)) {
+        TraceLog(LOG_WARNING, "HISTORY: %u MB is too little to keep",
+                 history_mb);
+    }
+    record_time_travel(tile_map);
+
+    ReplayWriter recorder = {0};
+    if (record_path) {
+        open_replay_writer(&recorder, record_path, game.xorshift,
+                           hash_interval, keyframe_interval, SNAPSHOT_FORMAT);
+        write_replay_intro(&recorder, intro_timeline.hash);
+    }
+
+    if (profile_name) {
+        start_profile_recording(profile_name);
+    }
+
+    u32 allocating_tick_count = 0;
+    u64 frame_start = get_nanoseconds();
+    while (!WindowShouldClose()) {
+        PROFILE_BEGIN(PROFILE_FRAME);
+        f64 tick_start = get_seconds();
+        if (IsKeyPressed(PROFILE_OVERLAY_KEY)) {
+            profiler.overlay_visible = !profiler.overlay_visible;
+        }
+        if (IsKeyPressed(FRAME_STATS_KEY)) {
+            log_frame_stats();
+        }
+        u64 simulate_ns = 0;
+        u64 allocations = allocation_count;
+        b32 paused = update_time_travel(tile_map, &recorder);
+        if (!paused) {
+            PROFILE_BEGIN(PROFILE_INPUT);
+            u8 input = read_input();
+            PROFILE_END(PROFILE_INPUT);
+            record_keyframe(&recorder, tile_map);
+            write_replay_input(&recorder, input);
+
+            // The simulation keeps its tick rate, events and replays count in
+            // ticks, but drawing only happens when there is something to
+            // show.
+            u64 simulate_start = get_nanoseconds();
+            simulate_tick(input, sprite_tiles, tile_map);
+            simulate_ns = get_nanoseconds() - simulate_start;
+            if (is_replay_hash_due(&recorder)) {
+                write_replay_hash(&recorder, hash_game_state(&game));
+            }
+        }
+        b32 presented = 0;
+        if (IsWindowMinimized()) {
+            // Redraw everything once the window is back.
+            renderer.compositor.valid = 0;
+        } else {
+            draw_frame(sprite_tiles, tile_map);
+            PROFILE_BEGIN(PROFILE_PRESENT);
+            presented = present_frame(screen_width, screen_height);
+            PROFILE_END(PROFILE_PRESENT);
+        }
+        if (!presented) {
+            PROFILE_BEGIN(PROFILE_IDLE);
+            idle_tick(tick_start);
+            PROFILE_END(PROFILE_IDLE);
+        }
+        if (!paused) {
+            game.tick++;
+            PROFILE_BEGIN(PROFILE_HISTORY);
+            record_time_travel(tile_map);
+            PROFILE_END(PROFILE_HISTORY);
+        }
+        if (allocation_count != allocations) {
+            allocating_tick_count++;
+        }
+        renderer.tick_count++;
+        PROFILE_END(PROFILE_FRAME);
+        profile_end_frame();
+
+        u64 frame_end = get_nanoseconds();
+        record_frame_time(frame_end - frame_start, simulate_ns);
+        frame_start = frame_end;
+    }
+    finish_profile_recording();
+
+    write_replay_score(&recorder, game.score, game.high_score);
+    close_replay_writer(&recorder);
+
+    if (swarm.update_count) {
+        TraceLog(LOG_INFO, "SWARM: %u ghosts, %.3f us per tick",
+                 swarm.count,
+                 swarm.update_time_total * 1000000.0 / swarm.update_count);
+    }
+
+    if (renderer.batch.frame_count) {
+        TraceLog(LOG_INFO, "RENDER: %.2f texture runs per frame",
+                 (f64)renderer.batch.run_total / renderer.batch.frame_count);
+        TraceLog(LOG_INFO,
+                 "RENDER: %.1f%% of the back buffer redrawn per frame",
+                 100.0 * (f64)renderer.compositor.dirty_pixel_total /
+                     ((f64)renderer.batch.frame_count * BACK_BUFFER_WIDTH *
+                      BACK_BUFFER_HEIGHT));
+    }
+    if (renderer.tick_count) {
+        TraceLog(LOG_INFO, "IDLE: %u of %u ticks presented nothing",
+                 renderer.idle_tick_count, renderer.tick_count);
+    }
+    if (renderer.soft_frame_count) {
+        TraceLog(LOG_INFO, "RENDER: %.3f us per software frame",
+                 renderer.soft_time_total * 1000000.0 /
+                     renderer.soft_frame_count);
+    }
+    if (time_travel.history.count) {
+        TraceLog(LOG_INFO, "HISTORY: %.1f minutes kept in %llu KB",
+                 (f64)time_travel.history.count / (60 * FPS),
+                 get_history_size(&time_travel.history) / 1024);
+    }
+    log_frame_stats();
+    log_memory_usage();
+    if (allocating_tick_count) {
+        TraceLog(LOG_WARNING, "MEMORY: %u ticks allocated",
+                 allocating_tick_count);
     }
 
-    UnloadSound(prelude);
-    UnloadSound(game.chomp_sfx);
-    UnloadSound(game.death_sfx);
-    UnloadSound(game.bonus_sfx);
-    UnloadSound(game.ghost_eat_sfx);
-    UnloadMusicStream(game.siren_bgm);
+    UnloadSound(audio.prelude_sfx);
+    UnloadSound(audio.chomp_sfx);
+    UnloadSound(audio.death_sfx);
+    UnloadSound(audio.bonus_sfx);
+    UnloadSound(audio.ghost_eat_sfx);
+    UnloadMusicStream(audio.siren_bgm);
     CloseAudioDevice();
     CloseWindow();
+    stop_logger();
 
     return 0;
 }
@@ -0,0 +1,262 @@
+#ifndef PLATFORM_H
+
+// Threads, locks, atomics, virtual memory and a monotonic clock for the tools
+// that run without a window (raylib's GetTime() needs InitWindow()). windows.h clashes
+// with raylib.h, so the handful of Win32 calls used here are declared by hand.
+
+#include "defines.h"
+
+#if defined(_WIN32)
+#include <intrin.h>
+#include <process.h>
+
+__declspec(dllimport) void __stdcall InitializeSRWLock(void *lock);
+__declspec(dllimport) void __stdcall AcquireSRWLockExclusive(void *lock);
+__declspec(dllimport) void __stdcall ReleaseSRWLockExclusive(void *lock);
+__declspec(dllimport) void __stdcall InitializeConditionVariable(void *cond);
+__declspec(dllimport) int __stdcall SleepConditionVariableSRW(
+    void *cond, void *lock, unsigned long ms, unsigned long flags);
+__declspec(dllimport) void __stdcall WakeConditionVariable(void *cond);
+__declspec(dllimport) void __stdcall WakeAllConditionVariable(void *cond);
+__declspec(dllimport) unsigned long __stdcall WaitForSingleObject(
+    void *handle, unsigned long ms);
+__declspec(dllimport) int __stdcall CloseHandle(void *handle);
+__declspec(dllimport) int __stdcall QueryPerformanceCounter(i64 *count);
+__declspec(dllimport) int __stdcall QueryPerformanceFrequency(i64 *frequency);
+__declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(
+    unsigned short group);
+__declspec(dllimport) void __stdcall Sleep(unsigned long ms);
+__declspec(dllimport) void *__stdcall VirtualAlloc(void *address, size_t size,
+                                                   unsigned long type,
+                                                   unsigned long protect);
+
+typedef struct {
+    void *handle;
+} Thread;
+
+typedef struct {
+    void *lock;
+} Mutex;
+
+typedef struct {
+    void *cond;
+} CondVar;
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_t handle;
+} Thread;
+
+typedef struct {
+    pthread_mutex_t lock;
+} Mutex;
+
+typedef struct {
+    pthread_cond_t cond;
+} CondVar;
+#endif
+
+typedef void (*ThreadProc)(void *data);
+
+typedef struct {
+    ThreadProc proc;
+    void *data;
+} ThreadStart;
+
+internal f64 get_seconds() {
+#if defined(_WIN32)
+    i64 count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (f64)count / (f64)frequency;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+#endif
+}
+
+internal u64 get_nanoseconds() {
+#if defined(_WIN32)
+    i64 count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (u64)(count / frequency) * 1000000000ULL +
+           (u64)(count % frequency) * 1000000000ULL / (u64)frequency;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+#endif
+}
+
+internal void sleep_seconds(f64 seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+#if defined(_WIN32)
+    Sleep((unsigned long)(seconds * 1000.0));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (f64)ts.tv_sec) * 1e9);
+    nanosleep(&ts, 0);
+#endif
+}
+
+internal u32 get_cpu_count() {
+#if defined(_WIN32)
+    // ALL_PROCESSOR_GROUPS
+    u32 count = (u32)GetActiveProcessorCount(0xFFFF);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (u32)count : 1;
+}
+
+// Address space only, nothing is backed until it is committed.
+internal void *reserve_memory(u64 size) {
+#if defined(_WIN32)
+    // MEM_RESERVE, PAGE_NOACCESS
+    return VirtualAlloc(0, (size_t)size, 0x2000, 0x01);
+#else
+    void *result =
+        mmap(0, (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return result == MAP_FAILED ? 0 : result;
+#endif
+}
+
+// Makes reserved pages usable. They read as zero the first time.
+internal b32 commit_memory(void *address, u64 size) {
+#if defined(_WIN32)
+    // MEM_COMMIT, PAGE_READWRITE
+    return VirtualAlloc(address, (size_t)size, 0x1000, 0x04) != 0;
+#else
+    return mprotect(address, (size_t)size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+// Loads acquire and stores release. Plain volatile accesses already do on
+// x86 and x64 under MSVC.
+internal u32 atomic_load_u32(volatile u32 *value) {
+#if defined(_WIN32)
+    return *value;
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+internal void atomic_store_u32(volatile u32 *value, u32 new_value) {
+#if defined(_WIN32)
+    *value = new_value;
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
+
+internal b32 atomic_cas_u32(volatile u32 *value, u32 expected, u32 desired) {
+#if defined(_WIN32)
+    return (u32)_InterlockedCompareExchange((volatile long *)value,
+                                           (long)desired,
+                                           (long)expected) == expected;
+#else
+    return __atomic_compare_exchange_n(value, &expected, desired, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+internal u32 atomic_add_u32(volatile u32 *value, u32 addend) {
+#if defined(_WIN32)
+    return (u32)_InterlockedExchangeAdd((volatile long *)value, (long)addend);
+#else
+    return __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+#endif
+}
+
+#if defined(_WIN32)
+internal unsigned __stdcall thread_main(void *arg) {
+#else
+internal void *thread_main(void *arg) {
+#endif
+    ThreadStart start = *(ThreadStart *)arg;
+    MemFree(arg);
+    start.proc(start.data);
+    return 0;
+}
+
+internal Thread start_thread(ThreadProc proc, void *data) {
+    Thread result = {0};
+    ThreadStart *start = (ThreadStart *)MemAlloc(sizeof(ThreadStart));
+    start->proc = proc;
+    start->data = data;
+#if defined(_WIN32)
+    result.handle = (void *)_beginthreadex(0, 0, thread_main, start, 0, 0);
+#else
+    pthread_create(&result.handle, 0, thread_main, start);
+#endif
+    return result;
+}
+
+internal void join_thread(Thread thread) {
+#if defined(_WIN32)
+    WaitForSingleObject(thread.handle, 0xFFFFFFFF);
+    CloseHandle(thread.handle);
+#else
+    pthread_join(thread.handle, 0);
+#endif
+}
+
+internal void init_mutex(Mutex *mutex) {
+#if defined(_WIN32)
+    InitializeSRWLock(&mutex->lock);
+#else
+    pthread_mutex_init(&mutex->lock, 0);
+#endif
+}
+
+internal void lock_mutex(Mutex *mutex) {
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+internal void unlock_mutex(Mutex *mutex) {
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+internal void init_cond(CondVar *cond) {
+#if defined(_WIN32)
+    InitializeConditionVariable(&cond->cond);
+#else
+    pthread_cond_init(&cond->cond, 0);
+#endif
+}
+
+internal void wait_cond(CondVar *cond, Mutex *mutex) {
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, 0xFFFFFFFF, 0);
+#else
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+#endif
+}
+
+internal void broadcast_cond(CondVar *cond) {
+#if defined(_WIN32)
+    WakeAllConditionVariable(&cond->cond);
+#else
+    pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+#define PLATFORM_H
+#endif
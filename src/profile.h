@@ -0,0 +1,233 @@
+#ifndef PROFILE_H
+
+// Scoped timers around the phases of a frame. Each zone adds up its time per
+// frame; the last PROFILE_HISTORY_FRAMES frames are kept for the overlay's
+// averages and maxima. With --profile <name>, every frame's zone times are
+// also kept for <name>.csv and every zone entry for <name>.json, which
+// chrome://tracing and Perfetto open. Define PACMAN_NO_PROFILE to compile the
+// timers out.
+
+#include <stdio.h>
+
+#include "defines.h"
+#include "platform.h"
+
+#define PROFILE_HISTORY_FRAMES 120
+#define PROFILE_FRAME_CAPACITY (1 << 16)
+#define PROFILE_EVENT_CAPACITY (1 << 19)
+
+typedef enum {
+    PROFILE_FRAME,
+    PROFILE_INPUT,
+    PROFILE_EVENTS,
+    PROFILE_PACMAN,
+    PROFILE_BLINKY,
+    PROFILE_PINKY,
+    PROFILE_INKY,
+    PROFILE_CLYDE,
+    PROFILE_SWARM,
+    PROFILE_MUSIC,
+    PROFILE_DOTS,
+    PROFILE_HUD,
+    PROFILE_DRAW,
+    PROFILE_COMPOSE,
+    PROFILE_PRESENT,
+    PROFILE_IDLE,
+    PROFILE_HISTORY,
+    PROFILE_ZONE_COUNT
+} ProfileZone;
+
+global const char *profile_zone_names[PROFILE_ZONE_COUNT] = {
+    "frame", "input",  "events", "pacman", "blinky",  "pinky",
+    "inky",  "clyde",  "swarm",  "music",  "dots",    "hud",
+    "draw",  "compose", "present", "idle",    "history",
+};
+
+typedef struct {
+    u8 zone;
+    u32 frame;
+    u64 begin;
+    u64 end;
+} ProfileEvent;
+
+typedef struct {
+    u64 begin[PROFILE_ZONE_COUNT];
+    u64 current[PROFILE_ZONE_COUNT];
+    u64 history[PROFILE_HISTORY_FRAMES][PROFILE_ZONE_COUNT];
+    u32 frame_count;
+    u64 start_time;
+    b32 overlay_visible;
+
+    // Only allocated when recording for export. Frames are in nanoseconds.
+    const char *export_name;
+    u32 (*frames)[PROFILE_ZONE_COUNT];
+    u32 recorded_frame_count;
+    ProfileEvent *events;
+    u32 event_count;
+    b32 truncated;
+} Profiler;
+
+// Only the main thread's is shown or written out.
+thread_global Profiler profiler = {0};
+
+#if !defined(PACMAN_NO_PROFILE)
+internal void profile_begin(ProfileZone zone) {
+    profiler.begin[zone] = get_nanoseconds();
+}
+
+internal void profile_end(ProfileZone zone) {
+    u64 now = get_nanoseconds();
+    profiler.current[zone] += now - profiler.begin[zone];
+    if (profiler.events) {
+        if (profiler.event_count < PROFILE_EVENT_CAPACITY) {
+            profiler.events[profiler.event_count++] = (ProfileEvent){
+                (u8)zone, profiler.frame_count, profiler.begin[zone], now};
+        } else {
+            profiler.truncated = 1;
+        }
+    }
+}
+
+#define PROFILE_BEGIN(zone) profile_begin(zone)
+#define PROFILE_END(zone) profile_end(zone)
+#else
+#define PROFILE_BEGIN(zone) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+#endif
+
+internal void start_profile_recording(const char *name) {
+    profiler.export_name = name;
+    profiler.frames = MemAlloc(PROFILE_FRAME_CAPACITY *
+                               sizeof(profiler.frames[0]));
+    profiler.events =
+        (ProfileEvent *)MemAlloc(PROFILE_EVENT_CAPACITY * sizeof(ProfileEvent));
+    profiler.start_time = get_nanoseconds();
+}
+
+// Closes the frame's zone times into the history.
+internal void profile_end_frame() {
+    u64 *history =
+        profiler.history[profiler.frame_count % PROFILE_HISTORY_FRAMES];
+    for (u32 zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        history[zone] = profiler.current[zone];
+        profiler.current[zone] = 0;
+    }
+    if (profiler.frames) {
+        if (profiler.recorded_frame_count < PROFILE_FRAME_CAPACITY) {
+            u32 *frame = profiler.frames[profiler.recorded_frame_count++];
+            for (u32 zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+                frame[zone] = history[zone] < 0xFFFFFFFF
+                                  ? (u32)history[zone]
+                                  : 0xFFFFFFFF;
+            }
+        } else {
+            profiler.truncated = 1;
+        }
+    }
+    profiler.frame_count++;
+}
+
+// Average and maximum over the kept history, in microseconds.
+internal void get_profile_stats(ProfileZone zone, f64 *average, f64 *max) {
+    u32 count = profiler.frame_count < PROFILE_HISTORY_FRAMES
+                    ? profiler.frame_count
+                    : PROFILE_HISTORY_FRAMES;
+    u64 total = 0;
+    u64 largest = 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 value = profiler.history[i][zone];
+        total += value;
+        if (value > largest) {
+            largest = value;
+        }
+    }
+    *average = count ? (f64)total / count / 1000.0 : 0.0;
+    *max = (f64)largest / 1000.0;
+}
+
+internal void draw_profile_overlay() {
+    if (!profiler.overlay_visible) {
+        return;
+    }
+    i32 line_height = 12;
+    DrawRectangle(4, 4, 200, (PROFILE_ZONE_COUNT + 1) * line_height + 4,
+                  Fade(BLACK, 0.75f));
+    DrawText("zone        avg us   max us", 8, 6, 10, YELLOW);
+    for (u32 zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        f64 average, max;
+        get_profile_stats(zone, &average, &max);
+        char line[64];
+        snprintf(line, sizeof(line), "%-10s %8.1f %8.1f",
+                 profile_zone_names[zone], average, max);
+        DrawText(line, 8, 6 + (zone + 1) * line_height, 10, WHITE);
+    }
+}
+
+internal b32 write_profile_csv(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "frame");
+    for (u32 zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        fprintf(file, ",%s_us", profile_zone_names[zone]);
+    }
+    fprintf(file, "\n");
+    for (u32 i = 0; i < profiler.recorded_frame_count; i++) {
+        fprintf(file, "%u", i);
+        for (u32 zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+            fprintf(file, ",%.3f", profiler.frames[i][zone] / 1000.0);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return 1;
+}
+
+// Chrome's trace event format, one complete ("X") event per zone entry.
+internal b32 write_profile_trace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (u32 i = 0; i < profiler.event_count; i++) {
+        ProfileEvent *event = &profiler.events[i];
+        fprintf(file,
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}\n",
+                i ? "," : "", profile_zone_names[event->zone],
+                (f64)(event->begin - profiler.start_time) / 1000.0,
+                (f64)(event->end - event->begin) / 1000.0, event->frame);
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+    return 1;
+}
+
+internal void finish_profile_recording() {
+    if (!profiler.frames) {
+        return;
+    }
+    char csv_path[512];
+    char trace_path[512];
+    snprintf(csv_path, sizeof(csv_path), "%s.csv", profiler.export_name);
+    snprintf(trace_path, sizeof(trace_path), "%s.json", profiler.export_name);
+    if (write_profile_csv(csv_path) && write_profile_trace(trace_path)) {
+        TraceLog(LOG_INFO, "PROFILE: %u frames written to %s and %s",
+                 profiler.recorded_frame_count, csv_path, trace_path);
+    } else {
+        TraceLog(LOG_WARNING, "PROFILE: Failed to write %s or %s", csv_path,
+                 trace_path);
+    }
+    if (profiler.truncated) {
+        TraceLog(LOG_WARNING, "PROFILE: Ran out of room, the end is missing");
+    }
+    MemFree(profiler.frames);
+    MemFree(profiler.events);
+    profiler.frames = 0;
+    profiler.events = 0;
+}
+
+#define PROFILE_H
+#endif
@@ -0,0 +1,589 @@
+#ifndef REPLAY_H
+
+// A replay is the RNG seed plus one input byte per tick from startup, which
+// is all the simulation needs to reproduce a session. It's written as a
+// stream of records that only ever get appended, so a session that crashes
+// still leaves a playable prefix:
+//
+//   RUN       varint tick count, input byte; inputs change rarely
+//   HASH      varint tick count, u64 hash of the state after that many
+//             ticks; written while the run it lands in is still pending, so
+//             hashing doesn't cut runs short
+//   KEYFRAME  varint size, varint packed size, the packed state before the
+//             next tick
+//   SCORE     varint score, varint high score; what the session ended on,
+//             written when the recording is closed
+//   INTRO     u64 hash of the attract sequence the session ran with, when
+//             it wasn't the built-in one; written before the first run
+//
+// State hashes let playback tell where a rebuilt binary stops doing what the
+// recording one did, to within a hash interval. Keyframes let tools start from
+// the nearest one instead of simulating from tick zero; what's in them is up to
+// the game, tagged by keyframe_format, and loading indexes them by tick.
+//
+// Versions 1 (raw input bytes), 2 (raw input bytes with a hash after every
+// hash_interval of them) and 3 (hashes without a tick count, after the run
+// they end) still load.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "defines.h"
+
+// "PMRP", little-endian.
+#define REPLAY_MAGIC 0x50524D50
+#define REPLAY_VERSION 4
+#define REPLAY_HEADER_SIZE 24
+#define REPLAY_V2_HEADER_SIZE 16
+#define REPLAY_V1_HEADER_SIZE 12
+// Ticks between recorded state hashes and keyframes, 0 for none. Once a
+// second and once a minute at 60 ticks a second; a hash every tick names the
+// exact tick a divergence starts on, but adds about 11 bytes a tick.
+#define REPLAY_DEFAULT_HASH_INTERVAL 60
+#define REPLAY_DEFAULT_KEYFRAME_INTERVAL 3600
+// A run is written out at least this often, which bounds what a crash loses.
+#define REPLAY_MAX_RUN_TICKS 60
+#define REPLAY_KEYFRAME_CAPACITY (16 * 1024)
+
+typedef enum {
+    REPLAY_RECORD_RUN = 1,
+    REPLAY_RECORD_HASH,
+    REPLAY_RECORD_KEYFRAME,
+    REPLAY_RECORD_SCORE,
+    REPLAY_RECORD_INTRO,
+} ReplayRecordType;
+
+typedef struct {
+    // The keyframe holds the state before this tick's input.
+    u32 tick;
+    u32 size;
+    u32 packed_size;
+    u8 *packed;
+} ReplayKeyframe;
+
+typedef struct {
+    u32 seed;
+    u32 tick_count;
+    u8 *inputs;
+    u32 hash_interval;
+    u32 hash_count;
+    // hashes[i] is the state after tick (i + 1) * hash_interval - 1.
+    u64 *hashes;
+    u32 keyframe_interval;
+    u32 keyframe_format;
+    // In tick order.
+    u32 keyframe_count;
+    ReplayKeyframe *keyframes;
+    // Missing when the session didn't close its recording.
+    b32 has_final_score;
+    u32 final_score;
+    u32 final_high_score;
+    // 0 for the built-in attract sequence.
+    u64 intro_hash;
+} Replay;
+
+typedef struct {
+    FILE *file;
+    u32 hash_interval;
+    u32 keyframe_interval;
+    u32 tick_count;
+    u8 run_input;
+    u32 run_length;
+} ReplayWriter;
+
+// Keyframes are packed into this before they're written.
+global u8 replay_pack_buffer[2 * REPLAY_KEYFRAME_CAPACITY + 16];
+
+internal u32 read_u32_le(const u8 *bytes) {
+    return (u32)bytes[0] | (u32)bytes[1] << 8 | (u32)bytes[2] << 16 |
+           (u32)bytes[3] << 24;
+}
+
+internal u64 read_u64_le(const u8 *bytes) {
+    return (u64)read_u32_le(bytes) | (u64)read_u32_le(bytes + 4) << 32;
+}
+
+internal void write_u32_le(FILE *file, u32 value) {
+    u8 bytes[4] = {(u8)value, (u8)(value >> 8), (u8)(value >> 16),
+                   (u8)(value >> 24)};
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+internal void write_u64_le(FILE *file, u64 value) {
+    write_u32_le(file, (u32)value);
+    write_u32_le(file, (u32)(value >> 32));
+}
+
+// LEB128: seven bits a byte, low first, the top bit set on all but the last.
+internal u32 put_varint(u8 *dst, u32 value) {
+    u32 count = 0;
+    while (value >= 0x80) {
+        dst[count++] = (u8)(value | 0x80);
+        value >>= 7;
+    }
+    dst[count++] = (u8)value;
+    return count;
+}
+
+internal void write_varint(FILE *file, u32 value) {
+    u8 bytes[5];
+    fwrite(bytes, 1, put_varint(bytes, value), file);
+}
+
+// Returns 0 when the varint runs past `end`.
+internal b32 read_varint(const u8 **cursor, const u8 *end, u32 *value) {
+    u32 result = 0;
+    for (u32 shift = 0; shift < 35 && *cursor < end; shift += 7) {
+        u8 byte = *(*cursor)++;
+        result |= (u32)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Game state is mostly zeros, so a keyframe is packed as alternating runs:
+// a varint count of zero bytes, a varint count of literal bytes and the
+// literals. Zero runs shorter than four stay literal. `dst` needs room for
+// twice `size` plus 16.
+internal u32 pack_zero_runs(const u8 *src, u32 size, u8 *dst) {
+    u32 packed = 0;
+    u32 i = 0;
+    while (i < size) {
+        u32 zeros = 0;
+        while (i + zeros < size && src[i + zeros] == 0) {
+            zeros++;
+        }
+        i += zeros;
+        u32 literal_start = i;
+        while (i < size) {
+            u32 run = 0;
+            while (i + run < size && run < 4 && src[i + run] == 0) {
+                run++;
+            }
+            if (run == 4 || (run && i + run == size)) {
+                break;
+            }
+            i += run ? run : 1;
+        }
+        packed += put_varint(dst + packed, zeros);
+        packed += put_varint(dst + packed, i - literal_start);
+        memcpy(dst + packed, src + literal_start, i - literal_start);
+        packed += i - literal_start;
+    }
+    return packed;
+}
+
+// Returns 0 when the packed data doesn't fill exactly `size` bytes.
+internal b32 unpack_zero_runs(const u8 *src, u32 packed_size, u8 *dst,
+                              u32 size) {
+    const u8 *cursor = src;
+    const u8 *end = src + packed_size;
+    u32 i = 0;
+    while (cursor < end) {
+        u32 zeros, literals;
+        if (!read_varint(&cursor, end, &zeros) ||
+            !read_varint(&cursor, end, &literals) || zeros > size - i ||
+            literals > size - i - zeros || literals > (u32)(end - cursor)) {
+            return 0;
+        }
+        memset(dst + i, 0, zeros);
+        i += zeros;
+        memcpy(dst + i, cursor, literals);
+        i += literals;
+        cursor += literals;
+    }
+    return i == size;
+}
+
+// Like unpack_zero_runs(), but XORs the literals into `dst` and leaves it be
+// under the zero runs, which is how a packed delta is applied.
+internal b32 xor_zero_runs(const u8 *src, u32 packed_size, u8 *dst, u32 size) {
+    const u8 *cursor = src;
+    const u8 *end = src + packed_size;
+    u32 i = 0;
+    while (cursor < end) {
+        u32 zeros, literals;
+        if (!read_varint(&cursor, end, &zeros) ||
+            !read_varint(&cursor, end, &literals) || zeros > size - i ||
+            literals > size - i - zeros || literals > (u32)(end - cursor)) {
+            return 0;
+        }
+        i += zeros;
+        for (u32 j = 0; j < literals; j++) {
+            dst[i + j] ^= cursor[j];
+        }
+        i += literals;
+        cursor += literals;
+    }
+    return i == size;
+}
+
+// Walks the records of a version 3 or 4 body. Counts only while `sized` is
+// null, so it runs once to size the arrays and once to fill them, never past
+// the counts `sized` holds from the first run, with the keyframes going to
+// `packed`, which holds the `*packed_total` bytes the first run found. Stops at
+// the first record a crash cut short; returns 0 for a record that can't have
+// been written, which means the file is damaged.
+internal b32 parse_replay_records(Replay *replay, const Replay *sized,
+                                  u32 version, const u8 *cursor,
+                                  const u8 *end, u8 *packed,
+                                  u32 *packed_total) {
+    u32 packed_capacity = *packed_total;
+    replay->tick_count = 0;
+    replay->hash_count = 0;
+    replay->keyframe_count = 0;
+    *packed_total = 0;
+    while (cursor < end) {
+        u8 type = *cursor++;
+        if (type == REPLAY_RECORD_RUN) {
+            u32 length;
+            if (!read_varint(&cursor, end, &length) || cursor >= end) {
+                break;
+            }
+            // The writer never makes longer runs, which also keeps the
+            // count from wrapping for any file that fits in memory.
+            if (length == 0 || length > REPLAY_MAX_RUN_TICKS ||
+                length > 0xFFFFFFFF - replay->tick_count) {
+                return 0;
+            }
+            u8 input = *cursor++;
+            if (sized) {
+                if (length > sized->tick_count - replay->tick_count) {
+                    break;
+                }
+                memset(replay->inputs + replay->tick_count, input, length);
+            }
+            replay->tick_count += length;
+        } else if (type == REPLAY_RECORD_HASH) {
+            u32 tick = replay->tick_count;
+            if ((version >= 4 && !read_varint(&cursor, end, &tick)) ||
+                end - cursor < 8) {
+                break;
+            }
+            u32 interval = replay->hash_interval;
+            b32 on_boundary = interval && tick && tick % interval == 0;
+            if (version >= 4) {
+                // One per interval, in order, and at most a run ahead of
+                // the inputs.
+                if (!on_boundary ||
+                    tick / interval - 1 != replay->hash_count ||
+                    (tick > replay->tick_count &&
+                     tick - replay->tick_count > REPLAY_MAX_RUN_TICKS)) {
+                    return 0;
+                }
+            }
+            if (on_boundary) {
+                u32 index = tick / interval - 1;
+                if (sized) {
+                    if (index >= sized->hash_count) {
+                        break;
+                    }
+                    replay->hashes[index] = read_u64_le(cursor);
+                }
+                replay->hash_count = index + 1;
+            }
+            cursor += 8;
+        } else if (type == REPLAY_RECORD_KEYFRAME) {
+            u32 size, packed_size;
+            if (!read_varint(&cursor, end, &size) ||
+                !read_varint(&cursor, end, &packed_size) ||
+                packed_size > (u32)(end - cursor)) {
+                break;
+            }
+            if (sized) {
+                if (replay->keyframe_count >= sized->keyframe_count ||
+                    packed_size > packed_capacity - *packed_total) {
+                    break;
+                }
+                ReplayKeyframe *keyframe =
+                    &replay->keyframes[replay->keyframe_count];
+                keyframe->tick = replay->tick_count;
+                keyframe->size = size;
+                keyframe->packed_size = packed_size;
+                keyframe->packed = packed + *packed_total;
+                memcpy(keyframe->packed, cursor, packed_size);
+            }
+            replay->keyframe_count++;
+            *packed_total += packed_size;
+            cursor += packed_size;
+        } else if (type == REPLAY_RECORD_SCORE) {
+            if (!read_varint(&cursor, end, &replay->final_score) ||
+                !read_varint(&cursor, end, &replay->final_high_score)) {
+                break;
+            }
+            replay->has_final_score = 1;
+        } else if (type == REPLAY_RECORD_INTRO) {
+            if (end - cursor < 8) {
+                break;
+            }
+            replay->intro_hash = read_u64_le(cursor);
+            cursor += 8;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Everything is pushed on `arena` and lives as long as it does.
+internal b32 load_replay(const char *path, Replay *replay, Arena *arena) {
+    *replay = (Replay){0};
+
+    i32 size = 0;
+    u8 *data = LoadFileData(path, &size);
+    if (!data) {
+        return 0;
+    }
+    u32 version = size >= REPLAY_V1_HEADER_SIZE ? read_u32_le(data + 4) : 0;
+    u32 header_size = version == 1   ? REPLAY_V1_HEADER_SIZE
+                      : version == 2 ? REPLAY_V2_HEADER_SIZE
+                                     : REPLAY_HEADER_SIZE;
+    if (size < (i32)header_size || read_u32_le(data) != REPLAY_MAGIC ||
+        version < 1 || version > REPLAY_VERSION) {
+        TraceLog(LOG_WARNING, "REPLAY: [%s] Not a replay file", path);
+        UnloadFileData(data);
+        return 0;
+    }
+
+    replay->seed = read_u32_le(data + 8);
+    if (version >= 2) {
+        replay->hash_interval = read_u32_le(data + 12);
+    }
+    const u8 *body = data + header_size;
+    const u8 *end = data + size;
+    b32 ok = 1;
+
+    if (version >= 3) {
+        replay->keyframe_interval = read_u32_le(data + 16);
+        replay->keyframe_format = read_u32_le(data + 20);
+        u32 packed_total = 0;
+        if (!parse_replay_records(replay, 0, version, body, end, 0,
+                                  &packed_total)) {
+            TraceLog(LOG_WARNING, "REPLAY: [%s] Damaged after tick %u", path,
+                     replay->tick_count);
+            UnloadFileData(data);
+            return 0;
+        }
+        Replay sized = *replay;
+        u32 tick_count = replay->tick_count;
+        u32 keyframe_count = replay->keyframe_count;
+        replay->inputs = push_array(arena, u8, tick_count + 1);
+        if (replay->hash_interval) {
+            replay->hashes = push_array(arena, u64, replay->hash_count + 1);
+            ok = replay->hashes != 0;
+        }
+        u8 *packed = 0;
+        if (keyframe_count) {
+            replay->keyframes =
+                push_array(arena, ReplayKeyframe, keyframe_count);
+            packed = push_array(arena, u8, packed_total);
+            ok = ok && replay->keyframes && packed;
+        }
+        ok = ok && replay->inputs;
+        if (ok) {
+            parse_replay_records(replay, &sized, version, body, end, packed,
+                                 &packed_total);
+        }
+        UnloadFileData(data);
+        return ok;
+    }
+
+    u32 body_size = (u32)(end - body);
+    replay->inputs = push_array(arena, u8, body_size + 1);
+    if (replay->hash_interval) {
+        replay->hashes = push_array(
+            arena, u64, body_size / (replay->hash_interval + 8) + 1);
+    }
+    if (!replay->inputs || (replay->hash_interval && !replay->hashes)) {
+        UnloadFileData(data);
+        return 0;
+    }
+
+    // A hash cut off by a crash is dropped, its inputs are kept.
+    const u8 *cursor = body;
+    while (cursor < end) {
+        replay->inputs[replay->tick_count++] = *cursor++;
+        if (replay->hash_interval &&
+            replay->tick_count % replay->hash_interval == 0) {
+            if (end - cursor < 8) {
+                break;
+            }
+            replay->hashes[replay->hash_count++] = read_u64_le(cursor);
+            cursor += 8;
+        }
+    }
+    UnloadFileData(data);
+    return 1;
+}
+
+// Whether a state hash was recorded after the tick with input `tick`.
+internal b32 get_replay_hash(Replay *replay, u32 tick, u64 *hash) {
+    if (!replay->hash_interval || (tick + 1) % replay->hash_interval != 0) {
+        return 0;
+    }
+    u32 index = (tick + 1) / replay->hash_interval - 1;
+    if (index >= replay->hash_count) {
+        return 0;
+    }
+    *hash = replay->hashes[index];
+    return 1;
+}
+
+// The first of the ticks a hash that doesn't match after `tick` can blame,
+// every one since the hash before it.
+internal u32 get_replay_hash_window(Replay *replay, u32 tick) {
+    return tick + 1 - replay->hash_interval;
+}
+
+// For logs: "tick 299", or "a tick from 240 to 299".
+internal const char *format_replay_ticks(char *buffer, u32 size, u32 first,
+                                         u32 last) {
+    if (first == last) {
+        snprintf(buffer, size, "tick %u", last);
+    } else {
+        snprintf(buffer, size, "a tick from %u to %u", first, last);
+    }
+    return buffer;
+}
+
+// The last keyframe at or before `tick`, or 0 if there is none or they were
+// written in another format.
+internal ReplayKeyframe *find_replay_keyframe(Replay *replay, u32 tick,
+                                              u32 format) {
+    if (replay->keyframe_format != format) {
+        return 0;
+    }
+    ReplayKeyframe *result = 0;
+    u32 low = 0;
+    u32 high = replay->keyframe_count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (replay->keyframes[mid].tick <= tick) {
+            result = &replay->keyframes[mid];
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return result;
+}
+
+internal b32 open_replay_writer(ReplayWriter *writer, const char *path,
+                                u32 seed, u32 hash_interval,
+                                u32 keyframe_interval, u32 keyframe_format) {
+    *writer = (ReplayWriter){0};
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        TraceLog(LOG_WARNING, "REPLAY: [%s] Failed to open for writing", path);
+        return 0;
+    }
+    writer->hash_interval = hash_interval;
+    writer->keyframe_interval = keyframe_interval;
+    write_u32_le(writer->file, REPLAY_MAGIC);
+    write_u32_le(writer->file, REPLAY_VERSION);
+    write_u32_le(writer->file, seed);
+    write_u32_le(writer->file, hash_interval);
+    write_u32_le(writer->file, keyframe_interval);
+    write_u32_le(writer->file, keyframe_format);
+    return 1;
+}
+
+// Writes out the pending run, and pushes everything so far to the disk.
+internal void flush_replay_run(ReplayWriter *writer) {
+    if (writer->run_length) {
+        fputc(REPLAY_RECORD_RUN, writer->file);
+        write_varint(writer->file, writer->run_length);
+        fputc(writer->run_input, writer->file);
+        writer->run_length = 0;
+    }
+    fflush(writer->file);
+}
+
+internal void write_replay_input(ReplayWriter *writer, u8 input) {
+    if (!writer->file) {
+        return;
+    }
+    if (writer->run_length &&
+        (input != writer->run_input ||
+         writer->run_length == REPLAY_MAX_RUN_TICKS)) {
+        flush_replay_run(writer);
+    }
+    writer->run_input = input;
+    writer->run_length++;
+    writer->tick_count++;
+}
+
+// Whether the tick with the last written input ends a hash interval, and
+// write_replay_hash() wants the state after it.
+internal b32 is_replay_hash_due(ReplayWriter *writer) {
+    return writer->file && writer->hash_interval &&
+           writer->tick_count % writer->hash_interval == 0;
+}
+
+// The hash names its tick, so the pending run carries on past it and only
+// goes to the disk when it ends.
+internal void write_replay_hash(ReplayWriter *writer, u64 hash) {
+    if (writer->file) {
+        fputc(REPLAY_RECORD_HASH, writer->file);
+        write_varint(writer->file, writer->tick_count);
+        write_u64_le(writer->file, hash);
+    }
+}
+
+// Whether write_replay_keyframe() wants the state before the next input.
+// Tick zero is where every session starts anyway.
+internal b32 is_replay_keyframe_due(ReplayWriter *writer) {
+    return writer->file && writer->keyframe_interval && writer->tick_count &&
+           writer->tick_count % writer->keyframe_interval == 0;
+}
+
+internal void write_replay_keyframe(ReplayWriter *writer, const void *state,
+                                    u32 size) {
+    if (!writer->file) {
+        return;
+    }
+    if (size > REPLAY_KEYFRAME_CAPACITY) {
+        TraceLog(LOG_WARNING, "REPLAY: %u byte keyframe doesn't fit", size);
+        return;
+    }
+    u32 packed_size =
+        pack_zero_runs((const u8 *)state, size, replay_pack_buffer);
+    flush_replay_run(writer);
+    fputc(REPLAY_RECORD_KEYFRAME, writer->file);
+    write_varint(writer->file, size);
+    write_varint(writer->file, packed_size);
+    fwrite(replay_pack_buffer, 1, packed_size, writer->file);
+}
+
+internal void write_replay_intro(ReplayWriter *writer, u64 hash) {
+    if (writer->file && hash) {
+        fputc(REPLAY_RECORD_INTRO, writer->file);
+        write_u64_le(writer->file, hash);
+    }
+}
+
+// The last thing written before closing.
+internal void write_replay_score(ReplayWriter *writer, u32 score,
+                                 u32 high_score) {
+    if (writer->file) {
+        flush_replay_run(writer);
+        fputc(REPLAY_RECORD_SCORE, writer->file);
+        write_varint(writer->file, score);
+        write_varint(writer->file, high_score);
+    }
+}
+
+internal void close_replay_writer(ReplayWriter *writer) {
+    if (writer->file) {
+        flush_replay_run(writer);
+        fclose(writer->file);
+        writer->file = 0;
+    }
+}
+
+#define REPLAY_H
+#endif
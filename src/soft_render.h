@@ -0,0 +1,254 @@
+#ifndef SOFT_RENDER_H
+
+// CPU rasterizer for the back buffer. Pixels are RGBA8 packed into a u32 with
+// the same byte order as PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 on little-endian
+// machines, so a finished frame can go straight to UpdateTexture() or
+// ExportImage(). Source pixels with zero alpha are the color key, everything
+// else is drawn opaque and scaled by the draw's alpha.
+
+#include <math.h>
+#include <string.h>
+
+#include "defines.h"
+#include "raylib.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_SSE2 1
+#endif
+
+#define SOFT_ALPHA_MASK 0xFF000000
+#define SOFT_TINT_CHUNK 256
+
+typedef struct {
+    u32 *pixels;
+    i32 width;
+    i32 height;
+} SoftImage;
+
+// Pixel bounds, x1 and y1 exclusive.
+typedef struct {
+    i32 x0;
+    i32 y0;
+    i32 x1;
+    i32 y1;
+} SoftRect;
+
+internal u32 soft_pack(Color color) {
+    u32 result;
+    memcpy(&result, &color, sizeof(result));
+    return result;
+}
+
+// Quads drawn by the GPU sample at pixel centers, so a sprite at x = 10.5
+// starts on pixel 10.
+internal i32 soft_round(f32 value) { return (i32)ceilf(value - 0.5f); }
+
+internal SoftImage soft_load_image(Image image) {
+    Image copy = ImageCopy(image);
+    ImageFormat(&copy, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+    SoftImage result = {(u32 *)copy.data, copy.width, copy.height};
+    // Zero every keyed pixel so tinting can't bring a color back into it.
+    for (i32 i = 0; i < result.width * result.height; i++) {
+        if ((result.pixels[i] & SOFT_ALPHA_MASK) == 0) {
+            result.pixels[i] = 0;
+        }
+    }
+    return result;
+}
+
+// Wraps the pixels without copying; don't unload the returned image.
+internal Image soft_to_image(SoftImage *image) {
+    Image result = {0};
+    result.data = image->pixels;
+    result.width = image->width;
+    result.height = image->height;
+    result.mipmaps = 1;
+    result.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+    return result;
+}
+
+internal void soft_clear(SoftImage *dst, Color color) {
+    u32 value = soft_pack(color);
+    u32 count = (u32)(dst->width * dst->height);
+    u32 i = 0;
+#ifdef SOFT_SSE2
+    __m128i fill = _mm_set1_epi32((i32)value);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst->pixels + i), fill);
+    }
+#endif
+    for (; i < count; i++) {
+        dst->pixels[i] = value;
+    }
+}
+
+internal void soft_clear_rect(SoftImage *dst, i32 x, i32 y, i32 width,
+                              i32 height, Color color) {
+    u32 value = soft_pack(color);
+    i32 x0 = x < 0 ? 0 : x;
+    i32 y0 = y < 0 ? 0 : y;
+    i32 x1 = x + width > dst->width ? dst->width : x + width;
+    i32 y1 = y + height > dst->height ? dst->height : y + height;
+    for (i32 row = y0; row < y1; row++) {
+        u32 *d = dst->pixels + row * dst->width;
+        for (i32 col = x0; col < x1; col++) {
+            d[col] = value;
+        }
+    }
+}
+
+// Copies every non-keyed pixel of the row.
+internal void soft_copy_row(u32 *dst, const u32 *src, i32 count) {
+    i32 i = 0;
+#ifdef SOFT_SSE2
+    __m128i alpha_mask = _mm_set1_epi32((i32)SOFT_ALPHA_MASK);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i key = _mm_cmpeq_epi32(_mm_and_si128(s, alpha_mask), zero);
+        d = _mm_or_si128(_mm_and_si128(key, d), _mm_andnot_si128(key, s));
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+    }
+#endif
+    for (; i < count; i++) {
+        if (src[i] & SOFT_ALPHA_MASK) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+// Blends every non-keyed pixel of the row over dst, alpha in [0, 256].
+internal void soft_blend_row(u32 *dst, const u32 *src, i32 count, u32 alpha) {
+    i32 i = 0;
+#ifdef SOFT_SSE2
+    __m128i alpha_mask = _mm_set1_epi32((i32)SOFT_ALPHA_MASK);
+    __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_set1_epi16((i16)alpha);
+    __m128i inv_a = _mm_set1_epi16((i16)(256 - alpha));
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i key = _mm_cmpeq_epi32(_mm_and_si128(s, alpha_mask), zero);
+
+        __m128i lo = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv_a));
+        __m128i hi = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv_a));
+        __m128i blended = _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+                                           _mm_srli_epi16(hi, 8));
+
+        d = _mm_or_si128(_mm_and_si128(key, d),
+                         _mm_andnot_si128(key, blended));
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+    }
+#endif
+    for (; i < count; i++) {
+        if (src[i] & SOFT_ALPHA_MASK) {
+            u32 result = 0;
+            for (u32 shift = 0; shift < 32; shift += 8) {
+                u32 s = (src[i] >> shift) & 0xFF;
+                u32 d = (dst[i] >> shift) & 0xFF;
+                result |= ((s * alpha + d * (256 - alpha)) >> 8) << shift;
+            }
+            dst[i] = result;
+        }
+    }
+}
+
+// Multiplies the color channels by the tint, leaving keyed pixels alone.
+internal void soft_tint_row(u32 *dst, const u32 *src, i32 count, Color tint) {
+    for (i32 i = 0; i < count; i++) {
+        u32 pixel = src[i];
+        u32 r = ((pixel & 0xFF) * tint.r + 127) / 255;
+        u32 g = (((pixel >> 8) & 0xFF) * tint.g + 127) / 255;
+        u32 b = (((pixel >> 16) & 0xFF) * tint.b + 127) / 255;
+        dst[i] = (pixel & SOFT_ALPHA_MASK) | (b << 16) | (g << 8) | r;
+    }
+}
+
+// Draws only the part of the image that lands inside clip, which must lie
+// within dst.
+internal void soft_draw_image_clipped(SoftImage *dst, SoftImage *src,
+                                      Rectangle src_rec, v2 pos, Color tint,
+                                      SoftRect clip) {
+    u32 alpha = tint.a + (tint.a >> 7);
+    if (alpha == 0) {
+        return;
+    }
+
+    i32 src_x = (i32)src_rec.x;
+    i32 src_y = (i32)src_rec.y;
+    i32 width = (i32)src_rec.width;
+    i32 height = (i32)src_rec.height;
+    i32 dst_x = soft_round(pos.x);
+    i32 dst_y = soft_round(pos.y);
+
+    if (dst_x < clip.x0) {
+        src_x += clip.x0 - dst_x;
+        width -= clip.x0 - dst_x;
+        dst_x = clip.x0;
+    }
+    if (dst_y < clip.y0) {
+        src_y += clip.y0 - dst_y;
+        height -= clip.y0 - dst_y;
+        dst_y = clip.y0;
+    }
+    if (src_x < 0 || src_y < 0) {
+        return;
+    }
+    if (dst_x + width > clip.x1) {
+        width = clip.x1 - dst_x;
+    }
+    if (dst_y + height > clip.y1) {
+        height = clip.y1 - dst_y;
+    }
+    if (src_x + width > src->width) {
+        width = src->width - src_x;
+    }
+    if (src_y + height > src->height) {
+        height = src->height - src_y;
+    }
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    b32 tinted = tint.r != 255 || tint.g != 255 || tint.b != 255;
+    u32 tinted_row[SOFT_TINT_CHUNK];
+
+    for (i32 y = 0; y < height; y++) {
+        const u32 *s = src->pixels + (src_y + y) * src->width + src_x;
+        u32 *d = dst->pixels + (dst_y + y) * dst->width + dst_x;
+
+        for (i32 x = 0; x < width; x += SOFT_TINT_CHUNK) {
+            i32 count = width - x;
+            if (count > SOFT_TINT_CHUNK) {
+                count = SOFT_TINT_CHUNK;
+            }
+            const u32 *row = s + x;
+            if (tinted) {
+                soft_tint_row(tinted_row, row, count, tint);
+                row = tinted_row;
+            }
+            if (alpha == 256) {
+                soft_copy_row(d + x, row, count);
+            } else {
+                soft_blend_row(d + x, row, count, alpha);
+            }
+        }
+    }
+}
+
+internal void soft_draw_image(SoftImage *dst, SoftImage *src,
+                              Rectangle src_rec, v2 pos, Color tint) {
+    soft_draw_image_clipped(dst, src, src_rec, pos, tint,
+                            (SoftRect){0, 0, dst->width, dst->height});
+}
+
+#define SOFT_RENDER_H
+#endif